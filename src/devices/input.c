@@ -41,6 +41,72 @@ input_getc (void)
   return key;
 }
 
+/* Reads up to SIZE keys from the input buffer into DST and
+   returns the number read.  Waits until at least one key is
+   available, then takes whatever else is already buffered
+   without waiting further, so the result may be short.
+
+   If LINE is true, reads a line instead: waits until a new-line
+   arrives or SIZE keys have been read, and stops after the
+   new-line.  Returns 0 only if SIZE is 0. */
+size_t
+input_read (void *dst_, size_t size, bool line) 
+{
+  uint8_t *dst = dst_;
+  enum intr_level old_level;
+  size_t cnt = 0;
+
+  if (size == 0)
+    return 0;
+
+  old_level = intr_disable ();
+  do
+    {
+      cnt += intq_getbuf (&buffer, dst + cnt, size - cnt,
+                          line ? '\n' : -1);
+      serial_notify ();
+    }
+  while (line && cnt < size && dst[cnt - 1] != '\n');
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
+/* Like input_read() with LINE false, but returns 0 at once
+   instead of waiting if no key is available. */
+size_t
+input_read_nonblock (void *dst, size_t size) 
+{
+  enum intr_level old_level;
+  size_t cnt = 0;
+
+  old_level = intr_disable ();
+  if (!intq_empty (&buffer))
+    cnt = input_read (dst, size, false);
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
+/* Returns true if a key is waiting in the input buffer.  If E is
+   nonnull, also adds E to the buffer's wait queue, to up SEMA
+   whenever keys arrive or are taken, before looking, so that no
+   arrival can be missed in between. */
+bool
+input_poll (struct wait_entry *e, struct semaphore *sema) 
+{
+  enum intr_level old_level;
+  bool ready;
+
+  old_level = intr_disable ();
+  if (e != NULL)
+    wait_queue_add (&buffer.poll, e, sema);
+  ready = !intq_empty (&buffer);
+  intr_set_level (old_level);
+
+  return ready;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
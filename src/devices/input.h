@@ -2,11 +2,18 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct semaphore;
+struct wait_entry;
+
 void input_init (void);
 void input_putc (uint8_t);
 uint8_t input_getc (void);
+size_t input_read (void *, size_t, bool line);
+size_t input_read_nonblock (void *, size_t);
+bool input_poll (struct wait_entry *, struct semaphore *);
 bool input_full (void);
 
 #endif /* devices/input.h */
@@ -12,6 +12,7 @@ intq_init (struct intq *q)
 {
   lock_init (&q->lock);
   q->not_full = q->not_empty = NULL;
+  wait_queue_init (&q->poll);
   q->head = q->tail = 0;
 }
 
@@ -54,6 +55,39 @@ intq_getc (struct intq *q)
   return byte;
 }
 
+/* Removes up to SIZE bytes from Q into BUF and returns the
+   number removed.  If Q is empty, sleeps until a byte is added;
+   otherwise takes only what is already there.  If DELIM is
+   nonnegative, stops after removing a byte equal to DELIM.
+   SIZE must be positive.
+   When called from an interrupt handler, Q must not be empty. */
+size_t
+intq_getbuf (struct intq *q, uint8_t *buf, size_t size, int delim) 
+{
+  size_t cnt = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (size > 0);
+  while (intq_empty (q)) 
+    {
+      ASSERT (!intr_context ());
+      lock_acquire (&q->lock);
+      wait (q, &q->not_empty);
+      lock_release (&q->lock);
+    }
+
+  while (cnt < size && !intq_empty (q)) 
+    {
+      uint8_t byte = q->buf[q->tail];
+      q->tail = next (q->tail);
+      buf[cnt++] = byte;
+      if (byte == delim)
+        break;
+    }
+  signal (q, &q->not_full);
+  return cnt;
+}
+
 /* Adds BYTE to the end of Q.
    If Q is full, sleeps until a byte is removed.
    When called from an interrupt handler, Q must not be full. */
@@ -98,9 +132,9 @@ wait (struct intq *q UNUSED, struct thread **waiter)
 /* WAITER must be the address of Q's not_empty or not_full
    member, and the associated condition must be true.  If a
    thread is waiting for the condition, wakes it up and resets
-   the waiting thread. */
+   the waiting thread.  Also wakes anyone polling Q. */
 static void
-signal (struct intq *q UNUSED, struct thread **waiter) 
+signal (struct intq *q, struct thread **waiter) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT ((waiter == &q->not_empty && !intq_empty (q))
@@ -111,4 +145,5 @@ signal (struct intq *q UNUSED, struct thread **waiter)
       thread_unblock (*waiter);
       *waiter = NULL;
     }
+  wait_queue_wake (&q->poll);
 }
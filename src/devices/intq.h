@@ -17,8 +17,11 @@
    protect kernel threads from one another, not from interrupt
    handlers. */
 
-/* Queue buffer size, in bytes. */
-#define INTQ_BUFSIZE 64
+/* Queue buffer size, in bytes.
+   Large enough that a burst of serial input, such as a file
+   piped into the serial port, isn't held off by a reader that
+   hasn't run yet. */
+#define INTQ_BUFSIZE 4096
 
 /* A circular queue of bytes. */
 struct intq
@@ -27,6 +30,7 @@ struct intq
     struct lock lock;           /* Only one thread may wait at once. */
     struct thread *not_full;    /* Thread waiting for not-full condition. */
     struct thread *not_empty;   /* Thread waiting for not-empty condition. */
+    struct wait_queue poll;     /* Woken whenever either changes. */
 
     /* Queue. */
     uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
@@ -39,5 +43,6 @@ bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
 void intq_putc (struct intq *, uint8_t);
+size_t intq_getbuf (struct intq *, uint8_t *, size_t, int delim);
 
 #endif /* devices/intq.h */
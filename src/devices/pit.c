@@ -11,15 +11,12 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
      - Channel 0 is connected to interrupt line 0, so that it can
-       be used as a periodic timer interrupt, as implemented in
-       Pintos in devices/timer.c.
+       be used as a timer interrupt, as implemented in Pintos in
+       devices/timer.c.
 
      - Channel 1 is used for dynamic RAM refresh (in older PCs).
        No good can come of messing with this.
@@ -81,3 +78,44 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Starts CHANNEL counting down once from COUNT PIT cycles, in
+   mode 0 ("interrupt on terminal count").  When the count
+   reaches zero the channel's output goes high, which for
+   channel 0 raises a timer interrupt, and stays high until the
+   channel is programmed again.  The counter itself keeps
+   decrementing, wrapping around from 0 to 65535, so that
+   pit_read_count() can still tell how long ago it expired.  A
+   COUNT of 0 is treated as 65536. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current value of CHANNEL's down-counter, latching
+   it first so that the two bytes are read consistently. */
+uint16_t
+pit_read_count (int channel)
+{
+  enum intr_level old_level;
+  uint16_t count;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, channel << 6);
+  count = inb (PIT_PORT_COUNTER (channel));
+  count |= inb (PIT_PORT_COUNTER (channel)) << 8;
+  intr_set_level (old_level);
+
+  return count;
+}
@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <string.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -33,6 +33,14 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable transmit and receive FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear transmit FIFO. */
+
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* Both set if FIFOs are enabled. */
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -51,11 +59,35 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, as a ring buffer.  TX_HEAD and TX_TAIL
+   count bytes ever added and removed, so TX_HEAD - TX_TAIL is the
+   number of bytes waiting and neither needs wrapping by hand.
+   Only accessed with interrupts off.
+
+   The ring is large so that a chatty process can hand over a
+   whole write() and get on with its work while the UART drains
+   it at 9600 bps from the transmit interrupt. */
+#define TXBUF_SIZE 16384        /* Must be a power of 2. */
+static uint8_t txbuf[TXBUF_SIZE];
+static size_t tx_head, tx_tail;
+
+/* Number of bytes the UART accepts each time it reports that its
+   transmitter is empty: 16 if the 16550A's FIFO is working, 1 on
+   older parts that ignore the FIFO Control Register. */
+static int tx_fifo_size;
+
+/* Threads wait on TX_ROOM, TX_WAITERS of them at a time, when
+   they find the ring full.  The interrupt handler wakes them all
+   once the ring has drained to half full. */
+static struct semaphore tx_room;
+static int tx_waiters;
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static bool tx_empty (void);
+static uint8_t tx_getc (void);
+static void tx_fill (void);
+static void tx_wake (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,10 +100,11 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
+  tx_fifo_size = (inb (IIR_REG) & IIR_FIFO) == IIR_FIFO ? 16 : 1;
   set_serial (9600);                    /* 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  sema_init (&tx_room, 0);
   mode = POLL;
 } 
 
@@ -98,31 +131,73 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte) 
 {
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  Once the port
+   is set up for interrupt-driven I/O, this only copies BUFFER
+   into the transmit ring and returns; the bytes go out later
+   from the interrupt handler. */
+void
+serial_putbuf (const void *buffer, size_t n) 
+{
+  const uint8_t *p = buffer;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (n-- > 0)
+        putc_poll (*p++); 
     }
   else 
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      while (n > 0) 
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          size_t ofs = tx_head % TXBUF_SIZE;
+          size_t chunk = TXBUF_SIZE - (tx_head - tx_tail);
+
+          if (chunk == 0) 
+            {
+              if (old_level == INTR_ON && !intr_context ()) 
+                {
+                  /* Wait for the interrupt handler to make
+                     room.  Make sure the transmitter is running
+                     first, or no interrupt would ever come. */
+                  tx_fill ();
+                  write_ier ();
+                  tx_waiters++;
+                  sema_down (&tx_room);
+                }
+              else
+                {
+                  /* Interrupts are off and the transmit ring is
+                     full.  If we wanted to wait for the ring to
+                     drain, we'd have to reenable interrupts.
+                     That's impolite, so we'll send a character
+                     via polling instead. */
+                  putc_poll (tx_getc ()); 
+                }
+              continue;
+            }
+
+          /* Copy as much as fits before the ring wraps. */
+          if (chunk > TXBUF_SIZE - ofs)
+            chunk = TXBUF_SIZE - ofs;
+          if (chunk > n)
+            chunk = n;
+          memcpy (txbuf + ofs, p, chunk);
+          tx_head += chunk;
+          p += chunk;
+          n -= chunk;
         }
 
-      intq_putc (&txq, byte); 
+      /* Start the transmitter if it is idle, instead of waiting
+         for an interrupt to do it. */
+      tx_fill ();
       write_ier ();
     }
   
@@ -135,8 +210,11 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (!tx_empty ())
+    putc_poll (tx_getc ());
+  tx_wake ();
+  if (mode == QUEUE)
+    write_ier ();
   intr_set_level (old_level);
 }
 
@@ -182,7 +260,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (!tx_empty ())
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -205,6 +283,52 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
+/* Returns true if the transmit ring is empty. */
+static bool
+tx_empty (void) 
+{
+  return tx_head == tx_tail;
+}
+
+/* Removes and returns the oldest byte in the transmit ring,
+   which must not be empty. */
+static uint8_t
+tx_getc (void) 
+{
+  ASSERT (!tx_empty ());
+  return txbuf[tx_tail++ % TXBUF_SIZE];
+}
+
+/* If the transmitter has drained, refills it from the transmit
+   ring with as many bytes as it will take. */
+static void
+tx_fill (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!tx_empty () && (inb (LSR_REG) & LSR_THRE) != 0) 
+    {
+      int i;
+
+      for (i = 0; i < tx_fifo_size && !tx_empty (); i++)
+        outb (THR_REG, tx_getc ());
+    }
+}
+
+/* Wakes the threads waiting for room in the transmit ring, if
+   it has drained to half full.  Waking them in a batch, rather
+   than each time a byte goes out, lets every writer copy a
+   large run at once. */
+static void
+tx_wake (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (tx_head - tx_tail <= TXBUF_SIZE / 2)
+    for (; tx_waiters > 0; tx_waiters--)
+      sema_up (&tx_room);
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
@@ -218,10 +342,11 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the hardware is ready for more to transmit, give it as
+     much as it will take, and let any waiting writers refill the
+     ring. */
+  tx_fill ();
+  tx_wake ();
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
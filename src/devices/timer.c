@@ -17,14 +17,56 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* The PIT is run in one-shot mode and reprogrammed on every
+   interrupt for whichever comes first: the next timer tick or
+   the earliest pending timer event.  While the idle thread is
+   the only runnable thread, tick boundaries are skipped
+   entirely and the PIT is programmed for the earliest event
+   only (see timer_idle()); the skipped ticks are accounted for
+   when the next interrupt arrives.
+
+   Time is kept in PIT cycles, which gives sub-microsecond
+   resolution for timer events. */
+
+/* PIT cycles per timer tick. */
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Shortest and longest intervals we program into the PIT.  The
+   minimum keeps a burst of closely spaced events from turning
+   into an interrupt storm; the maximum is the PIT's 16-bit
+   counter limit. */
+#define MIN_CYCLES 16
+#define MAX_CYCLES 0xffff
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* PIT cycles since OS booted, as of the last time the PIT was
+   loaded, and the count it was loaded with. */
+static int64_t cycles;
+static uint16_t loaded_count;
+
+/* PIT cycle at which timer tick number TICKS + 1 falls due. */
+static int64_t next_tick_cycles;
+
+/* Pending timer events, ordered by ascending expiry, so that
+   the timer interrupt only has to look at the front of the
+   list. */
+static struct list event_list;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static bool event_less (const struct list_elem *, const struct list_elem *,
+                        void *aux);
+static void event_add_at (struct timer_event *, int64_t deadline);
+static int64_t now_cycles (void);
+static void reprogram (int64_t deadline);
+static int64_t ns_to_cycles (int64_t ns);
+static int64_t cycles_to_ns (int64_t cycles);
+static void wake_thread (void *t);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -35,7 +77,10 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
-  pit_configure_channel (0, 2, TIMER_FREQ);
+  list_init (&event_list);
+  next_tick_cycles = TICK_CYCLES;
+  loaded_count = TICK_CYCLES;
+  pit_start_oneshot (0, loaded_count);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -66,12 +111,20 @@ timer_calibrate (void)
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
-/* Returns the number of timer ticks since the OS booted. */
+/* Returns the number of timer ticks since the OS booted.
+
+   After a tickless idle period, the PIT may not interrupt again
+   for up to MAX_CYCLES, so TICKS can lag behind if some other
+   interrupt woke a thread first.  Count the tick boundaries
+   already passed from the PIT itself instead. */
 int64_t
 timer_ticks (void) 
 {
   enum intr_level old_level = intr_disable ();
+  int64_t now = now_cycles ();
   int64_t t = ticks;
+  if (now >= next_tick_cycles)
+    t += (now - next_tick_cycles) / TICK_CYCLES + 1;
   intr_set_level (old_level);
   return t;
 }
@@ -84,16 +137,95 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the number of nanoseconds since the OS booted, with
+   the resolution of the PIT's input clock. */
+int64_t
+timer_ns (void)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t t = now_cycles ();
+  intr_set_level (old_level);
+  return cycles_to_ns (t);
+}
+
+/* Initializes timer event E to call FUNC, passing AUX, when it
+   expires.  E is not armed until timer_event_add() is called. */
+void
+timer_event_init (struct timer_event *e, timer_event_func *func, void *aux)
+{
+  ASSERT (e != NULL);
+  ASSERT (func != NULL);
+
+  e->func = func;
+  e->aux = aux;
+  e->armed = false;
+}
+
+/* Arms timer event E to expire at absolute PIT cycle DEADLINE.
+   Must be called with interrupts off. */
+static void
+event_add_at (struct timer_event *e, int64_t deadline)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!e->armed);
+
+  e->expires = deadline;
+  e->armed = true;
+  list_insert_ordered (&event_list, &e->elem, event_less, NULL);
+
+  /* If E is now the earliest event, the PIT may be programmed
+     for too late an interrupt. */
+  if (&e->elem == list_front (&event_list) && !intr_context ())
+    reprogram (next_tick_cycles);
+}
+
+/* Arms timer event E to expire NS nanoseconds from now.  When it
+   does, its function is called from the timer interrupt
+   handler, so it must not sleep.  E must not already be
+   armed. */
+void
+timer_event_add (struct timer_event *e, int64_t ns)
+{
+  enum intr_level old_level = intr_disable ();
+  event_add_at (e, now_cycles () + ns_to_cycles (ns));
+  intr_set_level (old_level);
+}
+
+/* Disarms timer event E.  Returns true if E was pending, false
+   if it had already expired or was never armed. */
+bool
+timer_event_cancel (struct timer_event *e)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_armed = e->armed;
+
+  if (was_armed)
+    {
+      list_remove (&e->elem);
+      e->armed = false;
+    }
+  intr_set_level (old_level);
+
+  return was_armed;
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
 timer_sleep (int64_t ticks) 
 {
+  ASSERT (intr_get_level () == INTR_ON);
+
   if (ticks > 0)
     {
-      enum intr_level old_level = intr_disable ();
-      struct thread* t = thread_current ();
-      t->wait_ticks = ticks;
+      /* Wake up exactly at the tick boundary, so that threads
+         sleeping for the same number of ticks wake together. */
+      struct timer_event e;
+      enum intr_level old_level;
+
+      timer_event_init (&e, wake_thread, thread_current ());
+      old_level = intr_disable ();
+      event_add_at (&e, (ticks + timer_ticks ()) * TICK_CYCLES);
       thread_block ();
       intr_set_level (old_level);
     }
@@ -169,16 +301,159 @@ timer_print_stats (void)
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
-/* Timer interrupt handler. */
+/* Called by the idle thread, with interrupts off, just before
+   it halts the CPU.  Reprograms the PIT to skip the periodic
+   ticks, which have nothing to preempt, and interrupt only for
+   the earliest pending timer event. */
+void
+timer_idle (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (&event_list))
+    reprogram (INT64_MAX);
+  else
+    reprogram (list_entry (list_front (&event_list),
+                           struct timer_event, elem)->expires);
+}
+
+/* Called by the idle thread, with interrupts off, once it is
+   about to give up the CPU to a thread that some other interrupt
+   has woken.  Accounts the tick boundaries that passed while
+   halted to the idle thread, which is still running, then
+   rearms the PIT for the next boundary, which timer_idle() may
+   have pushed far out, so that the woken thread gets its time
+   slice accounted. */
+void
+timer_resume (void)
+{
+  int64_t now = now_cycles ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (now >= next_tick_cycles)
+    {
+      ticks++;
+      next_tick_cycles += TICK_CYCLES;
+      thread_tick (ticks);
+    }
+  reprogram (next_tick_cycles);
+}
+
+/* Timer interrupt handler.  Accounts for every tick boundary
+   passed since the last interrupt, which may be several after
+   a tickless idle period, then fires every timer event that has
+   expired.  Because event_list is sorted, this only examines
+   the events actually fired plus one more. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  thread_tick ();
+  int64_t now = now_cycles ();
 
-  enum intr_level old_level = intr_disable ();
-  thread_foreach (thread_decrease_ticks, NULL);
-  intr_set_level (old_level);
+  while (now >= next_tick_cycles)
+    {
+      ticks++;
+      next_tick_cycles += TICK_CYCLES;
+      thread_tick (ticks);
+    }
+
+  while (!list_empty (&event_list))
+    {
+      struct timer_event *e = list_entry (list_front (&event_list),
+                                          struct timer_event, elem);
+      if (e->expires > now)
+        break;
+      list_pop_front (&event_list);
+      e->armed = false;
+      e->func (e->aux);
+    }
+
+  reprogram (next_tick_cycles);
+}
+
+/* Returns the current time in PIT cycles since boot.  Must be
+   called with interrupts off.
+
+   The PIT counts down from loaded_count and, after expiring,
+   keeps going from 65535, so the cycles elapsed since it was
+   loaded are the difference modulo 65536.  This is exact as long
+   as the PIT is reloaded at least every 65536 cycles (about 55
+   ms), which the timer interrupt guarantees. */
+static int64_t
+now_cycles (void)
+{
+  return cycles + (uint16_t) (loaded_count - pit_read_count (0));
+}
+
+/* Reprograms the PIT to interrupt at PIT cycle DEADLINE or at
+   the earliest pending timer event, whichever comes first, but
+   no sooner than MIN_CYCLES and no later than MAX_CYCLES from
+   now.  Must be called with interrupts off. */
+static void
+reprogram (int64_t deadline)
+{
+  int64_t delta;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!list_empty (&event_list))
+    {
+      int64_t expires = list_entry (list_front (&event_list),
+                                    struct timer_event, elem)->expires;
+      if (expires < deadline)
+        deadline = expires;
+    }
+
+  cycles = now_cycles ();
+  delta = deadline - cycles;
+  if (delta < MIN_CYCLES)
+    delta = MIN_CYCLES;
+  else if (delta > MAX_CYCLES)
+    delta = MAX_CYCLES;
+
+  loaded_count = delta;
+  pit_start_oneshot (0, loaded_count);
+}
+
+/* Timer event function that unblocks thread T_, preempting the
+   running thread if T_ has higher priority. */
+static void
+wake_thread (void *t_)
+{
+  struct thread *t = t_;
+
+  thread_unblock (t);
+  if (intr_context () && t->priority > thread_current ()->priority)
+    intr_yield_on_return ();
+}
+
+/* Returns true if timer event A expires before timer event B,
+   false otherwise. */
+static bool
+event_less (const struct list_elem *a, const struct list_elem *b,
+            void *aux UNUSED)
+{
+  return (list_entry (a, struct timer_event, elem)->expires
+          < list_entry (b, struct timer_event, elem)->expires);
+}
+
+/* Converts NS nanoseconds to PIT cycles, rounding up, without
+   overflowing for any plausible uptime. */
+static int64_t
+ns_to_cycles (int64_t ns)
+{
+  const int64_t ns_per_s = 1000 * 1000 * 1000;
+  return (ns / ns_per_s * PIT_HZ
+          + DIV_ROUND_UP (ns % ns_per_s * PIT_HZ, ns_per_s));
+}
+
+/* Converts PIT cycles C to nanoseconds, rounding down, without
+   overflowing for any plausible uptime. */
+static int64_t
+cycles_to_ns (int64_t c)
+{
+  const int64_t ns_per_s = 1000 * 1000 * 1000;
+  return c / PIT_HZ * ns_per_s + c % PIT_HZ * ns_per_s / PIT_HZ;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -234,11 +509,20 @@ real_time_sleep (int64_t num, int32_t denom)
          processes. */                
       timer_sleep (ticks); 
     }
-  else 
+  else if (num > 0)
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      /* Otherwise, block on a timer event for more accurate
+         sub-tick timing without burning CPU. */
+      const int64_t ns_per_s = 1000 * 1000 * 1000;
+      struct timer_event e;
+      enum intr_level old_level;
+
+      ASSERT (ns_per_s % denom == 0);
+      timer_event_init (&e, wake_thread, thread_current ());
+      old_level = intr_disable ();
+      event_add_at (&e, now_cycles () + ns_to_cycles (num * (ns_per_s / denom)));
+      thread_block ();
+      intr_set_level (old_level);
     }
 }
 
@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -24,6 +26,28 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* High-resolution timer events.  An event's function is called
+   from the timer interrupt handler once the event expires, so it
+   must not sleep. */
+typedef void timer_event_func (void *aux);
+struct timer_event
+  {
+    int64_t expires;            /* Expiry time, in PIT cycles. */
+    timer_event_func *func;     /* Function to call on expiry. */
+    void *aux;                  /* Argument to FUNC. */
+    bool armed;                 /* Is the event on the event list? */
+    struct list_elem elem;      /* Event list element. */
+  };
+
+int64_t timer_ns (void);
+void timer_event_init (struct timer_event *, timer_event_func *, void *aux);
+void timer_event_add (struct timer_event *, int64_t nanoseconds);
+bool timer_event_cancel (struct timer_event *);
+
+/* Tickless idle. */
+void timer_idle (void);
+void timer_resume (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
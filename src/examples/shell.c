@@ -5,6 +5,7 @@
 
 static void read_line (char line[], size_t);
 static bool backspace (char **pos, char line[]);
+static void run_pipeline (char *command);
 
 int
 main (void)
@@ -30,6 +31,8 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        run_pipeline (command);
       else
         {
           pid_t pid = exec (command);
@@ -44,6 +47,92 @@ main (void)
   return EXIT_SUCCESS;
 }
 
+/* Runs COMMAND, a series of commands separated by `|', with the
+   standard output of each connected to the standard input of the
+   next by a pipe.  All of the commands run at once; waits for
+   all of them to finish. */
+static void
+run_pipeline (char *command) 
+{
+  enum { MAX_STAGES = 8 };
+  char *stages[MAX_STAGES];
+  pid_t pids[MAX_STAGES];
+  int stage_cnt = 0;
+  int in = -1;
+  char *p;
+  int i;
+
+  /* Split COMMAND into stages. */
+  for (p = command; p != NULL && stage_cnt < MAX_STAGES; ) 
+    {
+      char *bar = strchr (p, '|');
+      if (bar != NULL)
+        *bar++ = '\0';
+      while (*p == ' ')
+        p++;
+      stages[stage_cnt++] = p;
+      p = bar;
+    }
+  if (p != NULL) 
+    {
+      printf ("too many commands in pipeline\n");
+      return;
+    }
+
+  /* Start each stage with its standard input reading from the
+     previous stage's pipe, if any, and its standard output
+     writing to a new pipe, unless it is the last stage.  Closing
+     a redirected descriptor returns it to the console.  The pipe
+     descriptors themselves are close-on-exec, so that a stage
+     gets only its copies on 0 and 1: if it also held the read
+     end of its own output pipe, it would never see that the next
+     stage had quit reading. */
+  for (i = 0; i < stage_cnt; i++) 
+    {
+      bool last = i == stage_cnt - 1;
+      int fds[2];
+
+      if (!last && pipe (fds) < 0) 
+        {
+          /* Run this stage without a pipe, and no more. */
+          printf ("pipe failed\n");
+          stage_cnt = i + 1;
+          last = true;
+        }
+      else if (!last) 
+        {
+          fcntl (fds[0], F_SETFD, FD_CLOEXEC);
+          fcntl (fds[1], F_SETFD, FD_CLOEXEC);
+        }
+      if (in >= 0)
+        dup2 (in, STDIN_FILENO);
+      if (!last)
+        dup2 (fds[1], STDOUT_FILENO);
+
+      pids[i] = exec (stages[i]);
+
+      if (!last) 
+        {
+          close (STDOUT_FILENO);
+          close (fds[1]);
+        }
+      if (in >= 0) 
+        {
+          close (STDIN_FILENO);
+          close (in);
+        }
+      in = last ? -1 : fds[0];
+    }
+  if (in >= 0)
+    close (in);
+
+  for (i = 0; i < stage_cnt; i++) 
+    if (pids[i] != PID_ERROR)
+      printf ("\"%s\": exit code %d\n", stages[i], wait (pids[i]));
+    else
+      printf ("\"%s\": exec failed\n", stages[i]);
+}
+
 /* Reads a line of input from the user into LINE, which has room
    for SIZE bytes.  Handles backspace and Ctrl+U in the ways
    expected by Unix users.  On return, LINE will always be
@@ -1,7 +1,8 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* An open file. */
 struct file 
@@ -9,26 +10,42 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    int ref_cnt;                /* References from file_open(), file_dup(). */
   };
 
+/* Cache of struct file. */
+static struct kmem_cache *file_cache;
+
+/* Protects every file's ref_cnt. */
+static struct lock ref_lock;
+
+/* Initializes the file module. */
+void
+file_init (void) 
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file), NULL);
+  lock_init (&ref_lock);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ref_cnt = 1;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (file_cache, file);
       return NULL; 
     }
 }
@@ -41,15 +58,35 @@ file_reopen (struct file *file)
   return file_open (inode_reopen (file->inode));
 }
 
-/* Closes FILE. */
+/* Takes another reference to FILE and returns it.  Unlike
+   file_reopen(), the references share one position, as file
+   descriptors copied by dup2() or across exec should.  Each
+   reference is dropped with file_close(). */
+struct file *
+file_dup (struct file *file) 
+{
+  lock_acquire (&ref_lock);
+  file->ref_cnt++;
+  lock_release (&ref_lock);
+  return file;
+}
+
+/* Drops a reference to FILE, closing it when none are left. */
 void
 file_close (struct file *file) 
 {
-  if (file != NULL)
+  bool last;
+
+  if (file == NULL)
+    return;
+  lock_acquire (&ref_lock);
+  last = --file->ref_cnt == 0;
+  lock_release (&ref_lock);
+  if (last)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      kmem_cache_free (file_cache, file); 
     }
 }
 
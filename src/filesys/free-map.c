@@ -1,52 +1,175 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+
+/* The disk is divided into allocation groups of GROUP_SECTORS
+   consecutive sectors, which is the number of sectors that one
+   sector of the free map file describes.  Each group's number of
+   free sectors is kept in memory, so that allocation can skip
+   over full groups without looking at their bits and can steer
+   new files toward the emptiest part of the disk.
+
+   After an allocation or release, only the sectors of the free
+   map file that cover groups that changed are rewritten.
+
+   A released sector is cleared in FREE_MAP, which is what goes
+   to disk, at once, but it stays set in BUSY_MAP, which is what
+   allocation searches, until the journal commit that frees it
+   has reached the disk.  Otherwise it could be handed out again
+   and overwritten with file data by a direct write, and a crash
+   before the commit would bring back the old metadata pointing
+   at it. */
+#define GROUP_SECTORS (BLOCK_SECTOR_SIZE * 8)
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct bitmap *busy_map;      /* FREE_MAP plus uncommitted frees. */
+static size_t group_cnt;             /* Number of allocation groups. */
+static size_t *group_free;           /* Free sectors in each group. */
+static bool *group_freed;            /* Group has uncommitted frees? */
+
+static void count_free (void);
+static bool frees_pending (void);
+static void sync_group (size_t group);
+static size_t group_of (block_sector_t);
+static size_t group_size (size_t group);
+static void account (block_sector_t, size_t cnt, bool allocated);
+static bool write_groups (block_sector_t, size_t cnt);
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
   free_map = bitmap_create (block_size (fs_device));
-  if (free_map == NULL)
+  busy_map = bitmap_create (block_size (fs_device));
+  if (free_map == NULL || busy_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  group_free = malloc (group_cnt * sizeof *group_free);
+  group_freed = calloc (group_cnt, sizeof *group_freed);
+  if (group_free == NULL || group_freed == NULL)
+    PANIC ("allocation group creation failed");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SIZE + 1, true);
+  count_free ();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  The sectors come from the allocation
+   group with the most free sectors, which spreads unrelated
+   files across the disk and leaves room for each to grow.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  size_t best = 0;
+  size_t g;
+
+  for (g = 1; g < group_cnt; g++)
+    if (group_free[g] > group_free[best])
+      best = g;
+  return free_map_allocate_near (best * GROUP_SECTORS, cnt, sectorp);
+}
+
+/* Allocates CNT consecutive sectors from the free map, as close
+   after HINT as possible, and stores the first into *SECTORP.
+   Looks first in HINT's allocation group at or after HINT, then
+   in later groups, and finally wraps around to the start of the
+   disk.  Groups that have no free sectors are skipped without
+   examining their bits.
+   Returns true if successful, false if not enough consecutive
+   sectors were available or if the free_map file could not be
+   written. */
+bool
+free_map_allocate_near (block_sector_t hint, size_t cnt,
+                        block_sector_t *sectorp)
+{
+  block_sector_t sector = BITMAP_ERROR;
+  size_t start, g;
+
+  if (hint >= bitmap_size (free_map))
+    hint = 0;
+  if (cnt == 0)
+    {
+      *sectorp = hint;
+      return true;
+    }
+
+  /* Search from HINT to the end of the disk. */
+  start = hint;
+  for (g = group_of (hint); g < group_cnt && group_free[g] == 0; g++)
+    start = (g + 1) * GROUP_SECTORS;
+  if (g < group_cnt)
+    sector = bitmap_scan (busy_map, start, cnt, false);
+
+  /* Then wrap around to the start of the disk. */
+  if (sector == BITMAP_ERROR && hint > 0)
+    {
+      for (g = 0; g < group_cnt && group_free[g] == 0; g++)
+        continue;
+      if (g < group_cnt)
+        sector = bitmap_scan (busy_map, g * GROUP_SECTORS, cnt, false);
+    }
+
+  /* Sectors released since the last commit can't be used until
+     it happens, so if they might make the difference, commit
+     now and try again. */
+  if (sector == BITMAP_ERROR)
+    return (frees_pending () && journal_commit ()
+            && free_map_allocate_near (hint, cnt, sectorp));
+  bitmap_set_multiple (free_map, sector, cnt, true);
+  bitmap_set_multiple (busy_map, sector, cnt, true);
+  account (sector, cnt, true);
+  if (free_map_file != NULL && !write_groups (sector, cnt))
     {
       bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      bitmap_set_multiple (busy_map, sector, cnt, false); 
+      account (sector, cnt, false);
+      return false;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  *sectorp = sector;
+  return true;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use, once
+   the current journal transaction has been committed. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  size_t g;
+
   ASSERT (bitmap_all (free_map, sector, cnt));
+  journal_forget (sector, cnt);
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  write_groups (sector, cnt);
+  if (cnt > 0)
+    for (g = group_of (sector); g <= group_of (sector + cnt - 1); g++)
+      group_freed[g] = true;
+}
+
+/* Called by the journal once a commit has reached the disk.
+   Makes the sectors released before it available for
+   allocation. */
+void
+free_map_commit (void) 
+{
+  size_t g;
+
+  for (g = 0; g < group_cnt; g++)
+    if (group_freed[g])
+      {
+        sync_group (g);
+        group_freed[g] = false;
+      }
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -56,8 +179,10 @@ free_map_open (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  inode_set_journaled (file_get_inode (free_map_file));
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  count_free ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -73,7 +198,7 @@ void
 free_map_create (void) 
 {
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
@@ -82,4 +207,109 @@ free_map_create (void)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+
+  /* The whole map was written directly, since it may be bigger
+     than the journal.  Later updates go through the journal. */
+  inode_set_journaled (file_get_inode (free_map_file));
+}
+
+/* Recomputes every allocation group's busy sectors and free
+   sector count from the free map. */
+static void
+count_free (void) 
+{
+  size_t g;
+
+  for (g = 0; g < group_cnt; g++)
+    sync_group (g);
+}
+
+/* Returns true if any released sectors are waiting for a journal
+   commit before they can be allocated. */
+static bool
+frees_pending (void) 
+{
+  size_t g;
+
+  for (g = 0; g < group_cnt; g++)
+    if (group_freed[g])
+      return true;
+  return false;
+}
+
+/* Copies allocation group GROUP of the free map into the busy
+   map, dropping any uncommitted frees, and recounts its free
+   sectors. */
+static void
+sync_group (size_t group) 
+{
+  size_t start = group * GROUP_SECTORS;
+  size_t i;
+
+  for (i = start; i < start + group_size (group); i++)
+    bitmap_set (busy_map, i, bitmap_test (free_map, i));
+  group_free[group] = bitmap_count (busy_map, start, group_size (group),
+                                    false);
+}
+
+/* Returns the allocation group that contains SECTOR. */
+static size_t
+group_of (block_sector_t sector) 
+{
+  return sector / GROUP_SECTORS;
+}
+
+/* Returns the number of sectors in allocation group GROUP.  Only
+   the last group may be smaller than GROUP_SECTORS. */
+static size_t
+group_size (size_t group) 
+{
+  size_t start = group * GROUP_SECTORS;
+  size_t end = start + GROUP_SECTORS;
+  size_t bit_cnt = bitmap_size (free_map);
+
+  return (end < bit_cnt ? end : bit_cnt) - start;
+}
+
+/* Adjusts the free counts of the allocation groups that contain
+   the CNT sectors starting at SECTOR, which have just been
+   ALLOCATED or released. */
+static void
+account (block_sector_t sector, size_t cnt, bool allocated) 
+{
+  while (cnt > 0)
+    {
+      size_t g = group_of (sector);
+      size_t group_end = (g + 1) * GROUP_SECTORS;
+      size_t n = group_end - sector < cnt ? group_end - sector : cnt;
+
+      if (allocated)
+        {
+          ASSERT (group_free[g] >= n);
+          group_free[g] -= n;
+        }
+      else
+        group_free[g] += n;
+      sector += n;
+      cnt -= n;
+    }
+}
+
+/* Writes the sectors of the free map file that describe the
+   allocation groups containing the CNT sectors starting at
+   SECTOR.  Writing whole sectors of the free map file spares the
+   file system a read-modify-write of each one.  Returns true if
+   successful, false otherwise. */
+static bool
+write_groups (block_sector_t sector, size_t cnt) 
+{
+  size_t first, last;
+
+  if (cnt == 0)
+    return true;
+  first = group_of (sector);
+  last = group_of (sector + cnt - 1);
+  return bitmap_write_range (free_map, free_map_file, first * GROUP_SECTORS,
+                             last * GROUP_SECTORS + group_size (last)
+                             - first * GROUP_SECTORS);
 }
@@ -5,7 +5,9 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -36,9 +38,14 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    bool journaled;                     /* Data is metadata, via journal. */
     struct inode_disk data;             /* Inode content. */
   };
 
+static void read_sector (const struct inode *, block_sector_t, void *);
+static void write_sector (const struct inode *, block_sector_t,
+                          const void *);
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -57,20 +64,26 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of struct inode. */
+static struct kmem_cache *inode_cache;
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  If JOURNALED, the data is metadata, such as a
+   directory, and is zeroed through the journal, so that it
+   reaches the disk in the same commit as the inode.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool journaled)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -87,16 +100,19 @@ inode_create (block_sector_t sector, off_t length)
       size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      if (free_map_allocate_near (sector, sectors, &disk_inode->start)) 
         {
-          block_write (fs_device, sector, disk_inode);
+          journal_write (sector, disk_inode);
           if (sectors > 0) 
             {
               static char zeros[BLOCK_SECTOR_SIZE];
               size_t i;
               
               for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
+                if (journaled)
+                  journal_write (disk_inode->start + i, zeros);
+                else
+                  block_write (fs_device, disk_inode->start + i, zeros);
             }
           success = true; 
         } 
@@ -127,7 +143,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -137,7 +153,8 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->journaled = false;
+  journal_read (inode->sector, &inode->data);
   return inode;
 }
 
@@ -176,12 +193,14 @@ inode_close (struct inode *inode)
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          journal_begin ();
           free_map_release (inode->sector, 1);
           free_map_release (inode->data.start,
                             bytes_to_sectors (inode->data.length)); 
+          journal_end ();
         }
 
-      free (inode); 
+      kmem_cache_free (inode_cache, inode); 
     }
 }
 
@@ -194,6 +213,16 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Marks INODE as holding file system metadata, such as a
+   directory or the free map, whose data must go through the
+   journal. */
+void
+inode_set_journaled (struct inode *inode) 
+{
+  ASSERT (inode != NULL);
+  inode->journaled = true;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -223,7 +252,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          read_sector (inode, sector_idx, buffer + bytes_read);
         }
       else 
         {
@@ -235,7 +264,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
               if (bounce == NULL)
                 break;
             }
-          block_read (fs_device, sector_idx, bounce);
+          read_sector (inode, sector_idx, bounce);
           memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         }
       
@@ -284,7 +313,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          write_sector (inode, sector_idx, buffer + bytes_written);
         }
       else 
         {
@@ -300,11 +329,11 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
              we're writing, then we need to read in the sector
              first.  Otherwise we start with a sector of all zeros. */
           if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
+            read_sector (inode, sector_idx, bounce);
           else
             memset (bounce, 0, BLOCK_SECTOR_SIZE);
           memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          write_sector (inode, sector_idx, bounce);
         }
 
       /* Advance. */
@@ -343,3 +372,24 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Reads SECTOR of INODE's data into BUFFER. */
+static void
+read_sector (const struct inode *inode, block_sector_t sector, void *buffer) 
+{
+  if (inode->journaled)
+    journal_read (sector, buffer);
+  else
+    block_read (fs_device, sector, buffer);
+}
+
+/* Writes BUFFER to SECTOR of INODE's data. */
+static void
+write_sector (const struct inode *inode, block_sector_t sector,
+              const void *buffer) 
+{
+  if (inode->journaled)
+    journal_write (sector, buffer);
+  else
+    block_write (fs_device, sector, buffer);
+}
@@ -0,0 +1,340 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* A redo journal for file system metadata.
+
+   Operations that modify metadata (inodes, directories, and the
+   free map) bracket their work with journal_begin() and
+   journal_end(), and write metadata sectors with journal_write()
+   instead of block_write().  The journal keeps the new contents
+   of each such sector in memory, absorbing repeated writes to
+   the same sector, and journal_read() returns them to readers
+   until they reach the disk.
+
+   Nothing is written to disk until a commit.  A commit writes
+   every pending sector to the log area, then writes the journal
+   header listing their home sectors, which is the commit point,
+   then writes each sector to its home, and finally clears the
+   header.  After a crash, journal_init() finds a nonempty header
+   and repeats the copy to the home sectors, so either all of a
+   commit's updates take effect or none do.
+
+   Commits happen only when no operation is in progress, so
+   every committed batch consists of whole operations.  The one
+   exception is journal_commit(), which the free map uses when it
+   runs out of space while sectors released by earlier operations
+   still await a commit.  Many
+   operations are grouped into each commit: one happens only
+   once the journal is half full, when an operation can't be
+   sure of fitting into what's left, or on journal_flush().
+
+   When sectors are released, journal_forget() discards their
+   pending contents, so that a stale metadata write can't later
+   land on top of whatever the sectors are reused for.  The free
+   map doesn't reuse them before free_map_commit() reports that
+   the commit freeing them is on disk. */
+
+/* Maximum number of distinct sectors a single operation may
+   write.  journal_begin() holds back new operations until this
+   many sectors are free for each one in progress. */
+#define OP_MAX_SECTORS 16
+
+/* Number of pending sectors at which journal_end() commits. */
+#define COMMIT_THRESHOLD (JOURNAL_SIZE / 2)
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* On-disk journal header.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t cnt;                       /* Number of committed sectors. */
+    block_sector_t home[JOURNAL_SIZE];  /* Where each log sector goes. */
+    uint32_t unused[126 - JOURNAL_SIZE]; /* Not used. */
+  };
+
+static struct lock journal_lock;    /* Protects the variables below. */
+static struct condition journal_cond; /* Signaled when a commit ends
+                                         or an operation finishes. */
+static int outstanding;             /* Operations in progress. */
+static bool committing;             /* Commit in progress? */
+
+/* Pending sectors.  DATA holds the contents of HOME[i] at
+   DATA + i * BLOCK_SECTOR_SIZE. */
+static size_t pending_cnt;
+static block_sector_t pending_home[JOURNAL_SIZE];
+static uint8_t *pending_data;
+
+static void commit (void);
+static void write_header (size_t cnt);
+static int find_pending (block_sector_t);
+static uint8_t *pending_sector (size_t idx);
+
+/* Initializes the journal.  If FORMAT is true, creates an empty
+   journal; otherwise, replays any commit that was interrupted by
+   a crash. */
+void
+journal_init (bool format) 
+{
+  lock_init (&journal_lock);
+  cond_init (&journal_cond);
+  pending_data = palloc_get_multiple (PAL_ASSERT,
+                                      JOURNAL_SIZE * BLOCK_SECTOR_SIZE
+                                      / PGSIZE);
+  ASSERT (sizeof (struct journal_header) == BLOCK_SECTOR_SIZE);
+
+  if (!format) 
+    {
+      struct journal_header *h = (struct journal_header *) pending_data;
+      size_t i;
+
+      block_read (fs_device, JOURNAL_SECTOR, h);
+      if (h->magic == JOURNAL_MAGIC && h->cnt > 0 && h->cnt <= JOURNAL_SIZE)
+        {
+          size_t cnt = h->cnt;
+
+          memcpy (pending_home, h->home, sizeof pending_home);
+          for (i = 0; i < cnt; i++)
+            {
+              block_read (fs_device, JOURNAL_SECTOR + 1 + i,
+                          pending_sector (0));
+              block_write (fs_device, pending_home[i], pending_sector (0));
+            }
+        }
+    }
+  write_header (0);
+}
+
+/* Begins a file system operation that may write metadata.  Waits
+   until the journal has room for the operation.  Operations may
+   nest within a thread; only the outermost counts. */
+void
+journal_begin (void) 
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->journal_depth++ > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  for (;;)
+    {
+      if (committing)
+        cond_wait (&journal_cond, &journal_lock);
+      else if (pending_cnt + (outstanding + 1) * OP_MAX_SECTORS
+               <= JOURNAL_SIZE)
+        break;
+      else if (outstanding == 0)
+        commit ();
+      else
+        cond_wait (&journal_cond, &journal_lock);
+    }
+  outstanding++;
+  lock_release (&journal_lock);
+}
+
+/* Ends a file system operation started with journal_begin().
+   Commits if this was the last operation in progress and the
+   journal is getting full. */
+void
+journal_end (void) 
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (cur->journal_depth > 0);
+  if (--cur->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (outstanding > 0);
+  if (--outstanding == 0 && pending_cnt >= COMMIT_THRESHOLD)
+    commit ();
+  cond_broadcast (&journal_cond, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Records BUFFER as the new contents of SECTOR, to be written at
+   the next commit.  If called outside an operation, the write is
+   an operation of its own. */
+void
+journal_write (block_sector_t sector, const void *buffer) 
+{
+  int idx;
+
+  if (thread_current ()->journal_depth == 0)
+    {
+      journal_begin ();
+      journal_write (sector, buffer);
+      journal_end ();
+      return;
+    }
+
+  lock_acquire (&journal_lock);
+  idx = find_pending (sector);
+  if (idx < 0)
+    {
+      if (pending_cnt >= JOURNAL_SIZE)
+        PANIC ("file system journal overflow");
+      idx = pending_cnt++;
+      pending_home[idx] = sector;
+    }
+  memcpy (pending_sector (idx), buffer, BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+}
+
+/* Reads SECTOR into BUFFER, taking its contents from the journal
+   if a write to it is pending. */
+void
+journal_read (block_sector_t sector, void *buffer) 
+{
+  int idx;
+
+  lock_acquire (&journal_lock);
+  idx = find_pending (sector);
+  if (idx >= 0)
+    memcpy (buffer, pending_sector (idx), BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+
+  if (idx < 0)
+    block_read (fs_device, sector, buffer);
+}
+
+/* Discards pending writes to the CNT sectors starting at SECTOR,
+   which are being released. */
+void
+journal_forget (block_sector_t sector, size_t cnt) 
+{
+  size_t i;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < pending_cnt; )
+    if (pending_home[i] - sector < cnt)
+      {
+        /* Move the last pending sector into this slot. */
+        pending_cnt--;
+        pending_home[i] = pending_home[pending_cnt];
+        memcpy (pending_sector (i), pending_sector (pending_cnt),
+                BLOCK_SECTOR_SIZE);
+      }
+    else
+      i++;
+  lock_release (&journal_lock);
+}
+
+/* Waits for operations in progress to finish, then commits all
+   pending writes. */
+void
+journal_flush (void) 
+{
+  lock_acquire (&journal_lock);
+  while (committing || outstanding > 0)
+    cond_wait (&journal_cond, &journal_lock);
+  commit ();
+  cond_broadcast (&journal_cond, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Commits all pending writes, usually from within an operation,
+   so that sectors released before it can be reused.  Does
+   nothing and returns false unless no other operation is in
+   progress, since waiting for others could deadlock on locks the
+   caller holds.  The caller's own writes so far are committed
+   along with everything else; they must leave the file system
+   consistent, e.g. by allocating sectors before linking them in,
+   so that a crash before the rest of the operation commits only
+   leaks sectors.  Returns true if a commit took place. */
+bool
+journal_commit (void) 
+{
+  int mine = thread_current ()->journal_depth > 0 ? 1 : 0;
+  bool ok;
+
+  lock_acquire (&journal_lock);
+  ok = outstanding == mine && !committing && pending_cnt > 0;
+  if (ok)
+    {
+      /* Step out of our own operation for the commit's sake;
+         COMMITTING keeps other operations from starting. */
+      outstanding -= mine;
+      commit ();
+      outstanding += mine;
+      cond_broadcast (&journal_cond, &journal_lock);
+    }
+  lock_release (&journal_lock);
+  return ok;
+}
+
+/* Writes all pending sectors to disk, as described at the top of
+   the file.  The journal lock must be held and no operation may
+   be in progress.  The lock is released during the disk writes,
+   but COMMITTING holds off new operations. */
+static void
+commit (void) 
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (outstanding == 0 && !committing);
+
+  if (pending_cnt == 0)
+    return;
+  committing = true;
+  lock_release (&journal_lock);
+
+  for (i = 0; i < pending_cnt; i++)
+    block_write (fs_device, JOURNAL_SECTOR + 1 + i, pending_sector (i));
+  write_header (pending_cnt);
+  for (i = 0; i < pending_cnt; i++)
+    block_write (fs_device, pending_home[i], pending_sector (i));
+  write_header (0);
+  free_map_commit ();
+
+  lock_acquire (&journal_lock);
+  pending_cnt = 0;
+  committing = false;
+}
+
+/* Writes a journal header that lists the first CNT entries of
+   PENDING_HOME. */
+static void
+write_header (size_t cnt) 
+{
+  static struct journal_header h;
+
+  memset (&h, 0, sizeof h);
+  h.magic = JOURNAL_MAGIC;
+  h.cnt = cnt;
+  memcpy (h.home, pending_home, cnt * sizeof *pending_home);
+  block_write (fs_device, JOURNAL_SECTOR, &h);
+}
+
+/* Returns the index of SECTOR among the pending sectors, or -1 if
+   there is no pending write to it.  The journal lock must be
+   held. */
+static int
+find_pending (block_sector_t sector) 
+{
+  size_t i;
+
+  for (i = 0; i < pending_cnt; i++)
+    if (pending_home[i] == sector)
+      return i;
+  return -1;
+}
+
+/* Returns the buffer for pending sector IDX. */
+static uint8_t *
+pending_sector (size_t idx) 
+{
+  return pending_data + idx * BLOCK_SECTOR_SIZE;
+}
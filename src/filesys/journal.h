@@ -0,0 +1,22 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Number of sectors the journal can hold.  The journal occupies
+   JOURNAL_SECTOR, which holds its header, and the JOURNAL_SIZE
+   sectors after it. */
+#define JOURNAL_SIZE 64
+
+void journal_init (bool format);
+void journal_begin (void);
+void journal_end (void);
+void journal_write (block_sector_t, const void *);
+void journal_read (block_sector_t, void *);
+void journal_forget (block_sector_t, size_t cnt);
+void journal_flush (void);
+bool journal_commit (void);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,22 @@
+#ifndef __LIB_FCNTL_H
+#define __LIB_FCNTL_H
+
+/* Interface to the fcntl() system call, shared by the kernel and
+   user programs. */
+
+/* Commands. */
+#define F_GETFL 1               /* Get descriptor flags. */
+#define F_SETFL 2               /* Set descriptor flags. */
+#define F_GETFD 3               /* Get close-on-exec flag. */
+#define F_SETFD 4               /* Set close-on-exec flag. */
+
+/* Descriptor flags.  Unlike in POSIX, they belong to a single
+   descriptor: copies made by dup2() or inherited across exec
+   start out with the same flags but change independently. */
+#define O_NONBLOCK 0x800        /* Fail instead of waiting. */
+
+/* Close-on-exec flag.  A descriptor with this flag is not
+   inherited across exec.  dup2() clears it in the copy. */
+#define FD_CLOEXEC 1
+
+#endif /* lib/fcntl.h */
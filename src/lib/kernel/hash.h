@@ -18,7 +18,10 @@
    conversion from a struct hash_elem back to a structure object
    that contains it.  This is the same technique used in the
    linked list implementation.  Refer to lib/kernel/list.h for a
-   detailed explanation. */
+   detailed explanation.
+
+   lib/kernel/ohash.h offers an open-addressing alternative with
+   the same interface. */
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -0,0 +1,484 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Minimum number of slots in a table. */
+#define MIN_SLOTS 8
+
+/* Number of slots of the old array that each insertion or
+   deletion examines while a resize is in progress, for each
+   time the old array is bigger than the current one.  After a
+   grow, the new array leaves room for at least half as many
+   operations as the old array has slots before it needs
+   resizing again.  After a shrink, which divides the size by 4,
+   only about a sixteenth as many operations may come before the
+   next grow, but the old array is then 4 times bigger, so it
+   still empties in time. */
+#define MOVE_STEPS 4
+
+static bool table_init (struct ohash_table *, size_t slot_cnt);
+static struct ohash_slot *table_find (struct ohash *, struct ohash_table *,
+                                      unsigned hash, struct hash_elem *);
+static void table_insert (struct ohash_table *, unsigned hash,
+                          struct hash_elem *);
+static void table_remove (struct ohash_table *, struct ohash_slot *);
+static struct ohash_slot *find_slot (struct ohash *, struct hash_elem *,
+                                     unsigned hash, struct ohash_table **);
+static struct hash_elem *insert_new (struct ohash *, unsigned hash,
+                                     struct hash_elem *);
+static void move_elems (struct ohash *, size_t steps);
+static void resize (struct ohash *, size_t elem_cnt);
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using LESS, given auxiliary data AUX. */
+bool
+ohash_init (struct ohash *h,
+            hash_hash_func *hash, hash_less_func *less, void *aux) 
+{
+  h->elem_cnt = 0;
+  h->old.slot_cnt = h->old.elem_cnt = 0;
+  h->old.slots = NULL;
+  h->move_idx = 0;
+  h->hash = hash;
+  h->less = less;
+  h->aux = aux;
+
+  return table_init (&h->cur, MIN_SLOTS);
+}
+
+/* Removes all the elements from H.
+   
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the hash element.  However, modifying hash
+   table H while ohash_clear() is running, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), yields undefined behavior,
+   whether done in DESTRUCTOR or elsewhere. */
+void
+ohash_clear (struct ohash *h, hash_action_func *destructor) 
+{
+  size_t i;
+
+  if (destructor != NULL)
+    ohash_apply (h, destructor);
+
+  for (i = 0; i < h->cur.slot_cnt; i++)
+    h->cur.slots[i].elem = NULL;
+  h->cur.elem_cnt = 0;
+
+  free (h->old.slots);
+  h->old.slot_cnt = h->old.elem_cnt = 0;
+  h->old.slots = NULL;
+  h->move_idx = 0;
+
+  h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash.  DESTRUCTOR may, if appropriate,
+   deallocate the memory used by the hash element.  However,
+   modifying hash table H while ohash_clear() is running, using
+   any of the functions ohash_clear(), ohash_destroy(),
+   ohash_insert(), ohash_replace(), or ohash_delete(), yields
+   undefined behavior, whether done in DESTRUCTOR or
+   elsewhere. */
+void
+ohash_destroy (struct ohash *h, hash_action_func *destructor) 
+{
+  ohash_clear (h, destructor);
+  free (h->cur.slots);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW.
+   Unlike hash_insert(), this can fail: if the table is full
+   and cannot be enlarged for lack of memory, returns NEW without
+   inserting it. */
+struct hash_elem *
+ohash_insert (struct ohash *h, struct hash_elem *new)
+{
+  unsigned hash = h->hash (new, h->aux);
+  struct ohash_slot *s = find_slot (h, new, hash, NULL);
+
+  if (s != NULL)
+    return s->elem;
+  return insert_new (h, hash, new);
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table, which is returned.  If there is no equal
+   element and the table is full and cannot be enlarged for lack
+   of memory, returns NEW without inserting it. */
+struct hash_elem *
+ohash_replace (struct ohash *h, struct hash_elem *new) 
+{
+  unsigned hash = h->hash (new, h->aux);
+  struct ohash_slot *s = find_slot (h, new, hash, NULL);
+
+  if (s != NULL)
+    {
+      struct hash_elem *old = s->elem;
+      s->elem = new;
+      return old;
+    }
+  return insert_new (h, hash, new);
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct hash_elem *
+ohash_find (struct ohash *h, struct hash_elem *e) 
+{
+  struct ohash_slot *s = find_slot (h, e, h->hash (e, h->aux), NULL);
+  return s != NULL ? s->elem : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct hash_elem *
+ohash_delete (struct ohash *h, struct hash_elem *e)
+{
+  struct ohash_table *t;
+  struct ohash_slot *s = find_slot (h, e, h->hash (e, h->aux), &t);
+  struct hash_elem *found;
+
+  if (s == NULL)
+    return NULL;
+
+  found = s->elem;
+  table_remove (t, s);
+  h->elem_cnt--;
+  resize (h, h->elem_cnt);
+  return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order. 
+   Modifying hash table H while ohash_apply() is running, using
+   any of the functions ohash_clear(), ohash_destroy(),
+   ohash_insert(), ohash_replace(), or ohash_delete(), yields
+   undefined behavior, whether done from ACTION or elsewhere. */
+void
+ohash_apply (struct ohash *h, hash_action_func *action) 
+{
+  struct ohash_iterator i;
+
+  ASSERT (action != NULL);
+
+  ohash_first (&i, h);
+  while (ohash_next (&i))
+    action (ohash_cur (&i), h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+      struct ohash_iterator i;
+
+      ohash_first (&i, h);
+      while (ohash_next (&i))
+        {
+          struct foo *f = hash_entry (ohash_cur (&i), struct foo, elem);
+          ...do something with f...
+        }
+
+   Modifying hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), invalidates all
+   iterators. */
+void
+ohash_first (struct ohash_iterator *i, struct ohash *h) 
+{
+  ASSERT (i != NULL);
+  ASSERT (h != NULL);
+
+  i->hash = h;
+  i->table = &h->old;
+  i->idx = 0;
+  i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order.
+
+   Modifying a hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), invalidates all
+   iterators. */
+struct hash_elem *
+ohash_next (struct ohash_iterator *i)
+{
+  ASSERT (i != NULL);
+
+  for (;;)
+    {
+      while (i->idx < i->table->slot_cnt)
+        {
+          struct ohash_slot *s = &i->table->slots[i->idx++];
+          if (s->elem != NULL)
+            return i->elem = s->elem;
+        }
+      if (i->table != &i->hash->old)
+        break;
+      i->table = &i->hash->cur;
+      i->idx = 0;
+    }
+
+  return i->elem = NULL;
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling ohash_first() but before ohash_next(). */
+struct hash_elem *
+ohash_cur (struct ohash_iterator *i) 
+{
+  return i->elem;
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h) 
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h) 
+{
+  return h->elem_cnt == 0;
+}
+
+/* Initializes T as an empty table of SLOT_CNT slots, which must
+   be a power of 2.  Returns true if successful, false if memory
+   allocation failed. */
+static bool
+table_init (struct ohash_table *t, size_t slot_cnt) 
+{
+  size_t i;
+
+  ASSERT ((slot_cnt & (slot_cnt - 1)) == 0);
+
+  t->slots = malloc (sizeof *t->slots * slot_cnt);
+  if (t->slots == NULL)
+    return false;
+  for (i = 0; i < slot_cnt; i++)
+    t->slots[i].elem = NULL;
+  t->slot_cnt = slot_cnt;
+  t->elem_cnt = 0;
+  return true;
+}
+
+/* Returns the slot in table T (of hash table H) that holds an
+   element equal to E, whose hash value is HASH, or a null
+   pointer if there is none.
+
+   Robin Hood placement guarantees that no element is farther
+   from its home slot than an element inserted before it that
+   it passed over, so the search can stop at the first slot
+   whose element is closer to home than E would be. */
+static struct ohash_slot *
+table_find (struct ohash *h, struct ohash_table *t, unsigned hash,
+            struct hash_elem *e) 
+{
+  size_t mask = t->slot_cnt - 1;
+  size_t i, dist;
+
+  if (t->elem_cnt == 0)
+    return NULL;
+
+  for (i = hash & mask, dist = 0; ; i = (i + 1) & mask, dist++)
+    {
+      struct ohash_slot *s = &t->slots[i];
+      if (s->elem == NULL || ((i - s->hash) & mask) < dist)
+        return NULL;
+      if (s->hash == hash
+          && !h->less (s->elem, e, h->aux) && !h->less (e, s->elem, h->aux))
+        return s;
+    }
+}
+
+/* Inserts E, whose hash value is HASH, into table T, which must
+   have at least one empty slot and must not already contain an
+   element equal to E.  Whenever the element being placed is
+   farther from its home slot than the one occupying a slot, the
+   two trade places and the displaced element continues the
+   search. */
+static void
+table_insert (struct ohash_table *t, unsigned hash, struct hash_elem *e) 
+{
+  size_t mask = t->slot_cnt - 1;
+  size_t i, dist;
+
+  ASSERT (t->elem_cnt < t->slot_cnt);
+
+  for (i = hash & mask, dist = 0; ; i = (i + 1) & mask, dist++)
+    {
+      struct ohash_slot *s = &t->slots[i];
+      size_t s_dist;
+
+      if (s->elem == NULL)
+        {
+          s->hash = hash;
+          s->elem = e;
+          t->elem_cnt++;
+          return;
+        }
+
+      s_dist = (i - s->hash) & mask;
+      if (s_dist < dist)
+        {
+          struct ohash_slot tmp = *s;
+          s->hash = hash;
+          s->elem = e;
+          hash = tmp.hash;
+          e = tmp.elem;
+          dist = s_dist;
+        }
+    }
+}
+
+/* Empties slot S of table T.  Shifts the elements that follow S
+   back by one slot until reaching an empty slot or an element
+   already in its home slot, so that no tombstones are needed. */
+static void
+table_remove (struct ohash_table *t, struct ohash_slot *s) 
+{
+  size_t mask = t->slot_cnt - 1;
+  size_t i = s - t->slots;
+
+  for (;;)
+    {
+      size_t j = (i + 1) & mask;
+      struct ohash_slot *next = &t->slots[j];
+
+      if (next->elem == NULL || ((j - next->hash) & mask) == 0)
+        break;
+      t->slots[i] = *next;
+      i = j;
+    }
+  t->slots[i].elem = NULL;
+  t->elem_cnt--;
+}
+
+/* Returns the slot in H that holds an element equal to E, whose
+   hash value is HASH, or a null pointer if there is none.  If
+   TABLEP is nonnull, stores the table containing the slot into
+   *TABLEP. */
+static struct ohash_slot *
+find_slot (struct ohash *h, struct hash_elem *e, unsigned hash,
+           struct ohash_table **tablep) 
+{
+  struct ohash_table *t = &h->cur;
+  struct ohash_slot *s = table_find (h, t, hash, e);
+
+  if (s == NULL)
+    {
+      t = &h->old;
+      s = table_find (h, t, hash, e);
+    }
+  if (tablep != NULL)
+    *tablep = t;
+  return s;
+}
+
+/* Inserts NEW, whose hash value is HASH and which has no equal
+   in H, into H.  Returns a null pointer if successful, or NEW if
+   the table is full and cannot be enlarged. */
+static struct hash_elem *
+insert_new (struct ohash *h, unsigned hash, struct hash_elem *new) 
+{
+  resize (h, h->elem_cnt + 1);
+  if (h->cur.elem_cnt + 1 >= h->cur.slot_cnt)
+    return new;
+
+  table_insert (&h->cur, hash, new);
+  h->elem_cnt++;
+  return NULL;
+}
+
+/* Moves elements from H's old slot array into its current one,
+   examining at most STEPS slots, and frees the old array once it
+   is empty. */
+static void
+move_elems (struct ohash *h, size_t steps) 
+{
+  while (h->old.elem_cnt > 0 && steps-- > 0)
+    {
+      struct ohash_slot *s = &h->old.slots[h->move_idx];
+
+      /* Removing S may shift the next element back into it, so
+         only advance past S once it is empty.  Elements may also
+         shift back around the end of the array into slots
+         already passed, which is why we stop only when the old
+         array is empty. */
+      if (s->elem != NULL)
+        {
+          table_insert (&h->cur, s->hash, s->elem);
+          table_remove (&h->old, s);
+        }
+      else
+        h->move_idx = (h->move_idx + 1) & (h->old.slot_cnt - 1);
+    }
+
+  if (h->old.slots != NULL && h->old.elem_cnt == 0) 
+    {
+      free (h->old.slots);
+      h->old.slots = NULL;
+      h->old.slot_cnt = 0;
+      h->move_idx = 0;
+    }
+}
+
+/* Continues any resize of H in progress, then starts a new one
+   if the current slot array is too full or too empty for
+   ELEM_CNT elements.  This function can fail because of an
+   out-of-memory condition, but that'll just make hash accesses
+   less efficient; we can still continue. */
+static void
+resize (struct ohash *h, size_t elem_cnt) 
+{
+  size_t slot_cnt = h->cur.slot_cnt;
+  size_t new_slot_cnt;
+  struct ohash_table new;
+
+  move_elems (h, MOVE_STEPS * (1 + h->old.slot_cnt / slot_cnt));
+
+  /* Keep the load factor between 1/8 and 3/4. */
+  if (elem_cnt * 4 <= slot_cnt * 3
+      && (elem_cnt * 8 >= slot_cnt || slot_cnt <= MIN_SLOTS))
+    return;
+
+  /* Aim for a load factor of at most 1/2. */
+  for (new_slot_cnt = MIN_SLOTS; new_slot_cnt < elem_cnt * 2;
+       new_slot_cnt *= 2)
+    continue;
+  if (new_slot_cnt == slot_cnt || !table_init (&new, new_slot_cnt))
+    return;
+
+  /* Only one resize can be in progress at a time, so finish the
+     previous one first.  With the steps above, this only does
+     any work if an earlier table_init() failed. */
+  move_elems (h, SIZE_MAX);
+
+  h->old = h->cur;
+  h->cur = new;
+  h->move_idx = 0;
+}
@@ -0,0 +1,89 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table.
+
+   An alternative to the chained hash table in hash.h with the
+   same interface, function for function, under the prefix
+   "ohash_".  Elements embed the same struct hash_elem as for
+   hash.h and use the same hash and comparison functions, so a
+   table can be switched from one implementation to the other by
+   changing only the names of the calls.
+
+   Instead of an array of lists, the table is an array of slots,
+   each of which holds a pointer to an element and a copy of the
+   element's hash value.  Elements are placed by linear probing
+   with Robin Hood reordering, which keeps every element close to
+   the slot its hash selects, and the cached hash values let a
+   lookup skip most mismatched slots without touching the
+   elements themselves.
+
+   When the table grows or shrinks, the old slot array is not
+   rehashed all at once.  Instead, each later insertion or
+   deletion moves a few of its elements into the new array, and
+   lookups consult both arrays until the old one is empty, so no
+   single operation pays for a whole rehash. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "hash.h"
+
+/* A slot in an open-addressing hash table. */
+struct ohash_slot
+  {
+    unsigned hash;              /* Hash value of ELEM. */
+    struct hash_elem *elem;     /* Element, or null if slot empty. */
+  };
+
+/* Array of slots. */
+struct ohash_table
+  {
+    size_t slot_cnt;            /* Number of slots, 0 or a power of 2. */
+    size_t elem_cnt;            /* Number of occupied slots. */
+    struct ohash_slot *slots;   /* Array of `slot_cnt' slots. */
+  };
+
+/* Open-addressing hash table. */
+struct ohash
+  {
+    size_t elem_cnt;            /* Number of elements in table. */
+    struct ohash_table cur;     /* Slots that receive new elements. */
+    struct ohash_table old;     /* Slots being emptied into CUR. */
+    size_t move_idx;            /* Next slot of OLD to empty. */
+    hash_hash_func *hash;       /* Hash function. */
+    hash_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `hash' and `less'. */
+  };
+
+/* An open-addressing hash table iterator. */
+struct ohash_iterator
+  {
+    struct ohash *hash;         /* The hash table. */
+    struct ohash_table *table;  /* Current slot array. */
+    size_t idx;                 /* Index of current slot in TABLE. */
+    struct hash_elem *elem;     /* Current hash element. */
+  };
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *, hash_hash_func *, hash_less_func *,
+                 void *aux);
+void ohash_clear (struct ohash *, hash_action_func *);
+void ohash_destroy (struct ohash *, hash_action_func *);
+
+/* Search, insertion, deletion. */
+struct hash_elem *ohash_insert (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_replace (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_find (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_delete (struct ohash *, struct hash_elem *);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, hash_action_func *);
+void ohash_first (struct ohash_iterator *, struct ohash *);
+struct hash_elem *ohash_next (struct ohash_iterator *);
+struct hash_elem *ohash_cur (struct ohash_iterator *);
+
+/* Information. */
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -0,0 +1,455 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* Our red-black trees follow the usual rules, as in [CLRS]
+   chapter 13, with null pointers standing in for the black leaf
+   nodes:
+
+     1. Every element is red or black.
+
+     2. The root is black.
+
+     3. A red element has no red children.
+
+     4. Every path from an element down to a null pointer passes
+        through the same number of black elements.
+
+   Together these keep the longest path from the root to a leaf
+   at most twice as long as the shortest, so that the tree's
+   height is O(log n). */
+
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void replace_child (struct rb_tree *, struct rb_elem *old,
+                           struct rb_elem *new);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+                          struct rb_elem *parent);
+static struct rb_elem *leftmost (struct rb_elem *);
+static struct rb_elem *rightmost (struct rb_elem *);
+
+/* Returns true if E is red, false if it is black or null. */
+static inline bool
+is_red (const struct rb_elem *e) 
+{
+  return e != NULL && e->red;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux) 
+{
+  ASSERT (tree != NULL);
+  ASSERT (less != NULL);
+
+  tree->root = NULL;
+  tree->elem_cnt = 0;
+  tree->less = less;
+  tree->aux = aux;
+}
+
+/* Inserts ELEM into TREE, after any elements that compare equal
+   to it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_elem *elem) 
+{
+  struct rb_elem *parent = NULL;
+  struct rb_elem **link = &tree->root;
+
+  ASSERT (tree != NULL);
+  ASSERT (elem != NULL);
+
+  while (*link != NULL) 
+    {
+      parent = *link;
+      link = (tree->less (elem, parent, tree->aux)
+              ? &parent->left : &parent->right);
+    }
+
+  elem->parent = parent;
+  elem->left = elem->right = NULL;
+  elem->red = true;
+  *link = elem;
+  tree->elem_cnt++;
+
+  insert_fixup (tree, elem);
+}
+
+/* Removes ELEM, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_elem *elem) 
+{
+  struct rb_elem *child, *parent;
+  bool removed_red;
+
+  ASSERT (tree != NULL);
+  ASSERT (elem != NULL);
+  ASSERT (tree->elem_cnt > 0);
+
+  if (elem->left == NULL || elem->right == NULL) 
+    {
+      /* ELEM has at most one child, which takes its place. */
+      child = elem->left != NULL ? elem->left : elem->right;
+      parent = elem->parent;
+      removed_red = elem->red;
+      replace_child (tree, elem, child);
+      if (child != NULL)
+        child->parent = parent;
+    }
+  else
+    {
+      /* ELEM has two children.  Its successor, which has no left
+         child, takes its place, and the successor's right child
+         takes the successor's place. */
+      struct rb_elem *next = leftmost (elem->right);
+
+      removed_red = next->red;
+      child = next->right;
+      if (next->parent == elem)
+        parent = next;
+      else
+        {
+          parent = next->parent;
+          replace_child (tree, next, child);
+          if (child != NULL)
+            child->parent = parent;
+          next->right = elem->right;
+          next->right->parent = next;
+        }
+      replace_child (tree, elem, next);
+      next->parent = elem->parent;
+      next->left = elem->left;
+      next->left->parent = next;
+      next->red = elem->red;
+    }
+  tree->elem_cnt--;
+
+  /* Removing a black element shortened the paths through CHILD's
+     position by one black element. */
+  if (!removed_red)
+    remove_fixup (tree, child, parent);
+}
+
+/* Returns an element in TREE equal to KEY, or a null pointer if
+   there is none.  If several elements are equal to KEY, returns
+   an arbitrary one of them. */
+struct rb_elem *
+rb_find (const struct rb_tree *tree, const struct rb_elem *key) 
+{
+  struct rb_elem *e = tree->root;
+
+  while (e != NULL) 
+    {
+      if (tree->less (key, e, tree->aux))
+        e = e->left;
+      else if (tree->less (e, key, tree->aux))
+        e = e->right;
+      else
+        return e;
+    }
+  return NULL;
+}
+
+/* Returns the first element in TREE that is not less than KEY,
+   or a null pointer if there is none. */
+struct rb_elem *
+rb_lower_bound (const struct rb_tree *tree, const struct rb_elem *key) 
+{
+  struct rb_elem *e = tree->root;
+  struct rb_elem *bound = NULL;
+
+  while (e != NULL) 
+    if (tree->less (e, key, tree->aux))
+      e = e->right;
+    else
+      {
+        bound = e;
+        e = e->left;
+      }
+  return bound;
+}
+
+/* Returns the first element in TREE that is greater than KEY, or
+   a null pointer if there is none. */
+struct rb_elem *
+rb_upper_bound (const struct rb_tree *tree, const struct rb_elem *key) 
+{
+  struct rb_elem *e = tree->root;
+  struct rb_elem *bound = NULL;
+
+  while (e != NULL) 
+    if (tree->less (key, e, tree->aux))
+      {
+        bound = e;
+        e = e->left;
+      }
+    else
+      e = e->right;
+  return bound;
+}
+
+/* Returns the smallest element in TREE, or a null pointer if
+   TREE is empty. */
+struct rb_elem *
+rb_min (const struct rb_tree *tree) 
+{
+  return tree->root != NULL ? leftmost (tree->root) : NULL;
+}
+
+/* Returns the largest element in TREE, or a null pointer if TREE
+   is empty. */
+struct rb_elem *
+rb_max (const struct rb_tree *tree) 
+{
+  return tree->root != NULL ? rightmost (tree->root) : NULL;
+}
+
+/* Returns the element that follows ELEM in its tree, or a null
+   pointer if ELEM is the largest element. */
+struct rb_elem *
+rb_next (const struct rb_elem *elem) 
+{
+  ASSERT (elem != NULL);
+
+  if (elem->right != NULL)
+    return leftmost (elem->right);
+  while (elem->parent != NULL && elem == elem->parent->right)
+    elem = elem->parent;
+  return elem->parent;
+}
+
+/* Returns the element that precedes ELEM in its tree, or a null
+   pointer if ELEM is the smallest element. */
+struct rb_elem *
+rb_prev (const struct rb_elem *elem) 
+{
+  ASSERT (elem != NULL);
+
+  if (elem->left != NULL)
+    return rightmost (elem->left);
+  while (elem->parent != NULL && elem == elem->parent->left)
+    elem = elem->parent;
+  return elem->parent;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (const struct rb_tree *tree) 
+{
+  return tree->elem_cnt;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *tree) 
+{
+  return tree->root == NULL;
+}
+
+/* Restores the red-black properties after inserting red element
+   E, which may have a red parent. */
+static void
+insert_fixup (struct rb_tree *tree, struct rb_elem *e) 
+{
+  struct rb_elem *parent;
+
+  while ((parent = e->parent) != NULL && parent->red) 
+    {
+      /* PARENT is red, so it is not the root and has a parent. */
+      struct rb_elem *grandparent = parent->parent;
+
+      if (parent == grandparent->left) 
+        {
+          struct rb_elem *uncle = grandparent->right;
+          if (is_red (uncle)) 
+            {
+              /* Push the grandparent's blackness down a level and
+                 continue from the grandparent. */
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->right) 
+            {
+              rotate_left (tree, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_right (tree, grandparent);
+        }
+      else
+        {
+          struct rb_elem *uncle = grandparent->left;
+          if (is_red (uncle)) 
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->left) 
+            {
+              rotate_right (tree, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_left (tree, grandparent);
+        }
+    }
+  tree->root->red = false;
+}
+
+/* Restores the red-black properties after removing a black
+   element, given that E, which may be null, took its place as a
+   child of PARENT and that paths through E are one black element
+   short. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_elem *e, struct rb_elem *parent) 
+{
+  while (e != tree->root && !is_red (e)) 
+    {
+      /* E's sibling must exist, because paths through it have at
+         least one black element more than paths through E. */
+      if (e == parent->left) 
+        {
+          struct rb_elem *sibling = parent->right;
+          if (sibling->red) 
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_left (tree, parent);
+              sibling = parent->right;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right)) 
+            {
+              /* Shorten the sibling's paths too and move the
+                 problem up a level. */
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+            }
+          else
+            {
+              if (!is_red (sibling->right)) 
+                {
+                  sibling->left->red = false;
+                  sibling->red = true;
+                  rotate_right (tree, sibling);
+                  sibling = parent->right;
+                }
+              sibling->red = parent->red;
+              parent->red = false;
+              sibling->right->red = false;
+              rotate_left (tree, parent);
+              e = tree->root;
+              break;
+            }
+        }
+      else
+        {
+          struct rb_elem *sibling = parent->left;
+          if (sibling->red) 
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_right (tree, parent);
+              sibling = parent->left;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right)) 
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+            }
+          else
+            {
+              if (!is_red (sibling->left)) 
+                {
+                  sibling->right->red = false;
+                  sibling->red = true;
+                  rotate_left (tree, sibling);
+                  sibling = parent->left;
+                }
+              sibling->red = parent->red;
+              parent->red = false;
+              sibling->left->red = false;
+              rotate_right (tree, parent);
+              e = tree->root;
+              break;
+            }
+        }
+    }
+  if (e != NULL)
+    e->red = false;
+}
+
+/* Rotates the subtree rooted at E to the left, so that E's right
+   child takes E's place and E becomes its left child. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_elem *e) 
+{
+  struct rb_elem *child = e->right;
+
+  e->right = child->left;
+  if (child->left != NULL)
+    child->left->parent = e;
+  child->parent = e->parent;
+  replace_child (tree, e, child);
+  child->left = e;
+  e->parent = child;
+}
+
+/* Rotates the subtree rooted at E to the right, so that E's left
+   child takes E's place and E becomes its right child. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_elem *e) 
+{
+  struct rb_elem *child = e->left;
+
+  e->left = child->right;
+  if (child->right != NULL)
+    child->right->parent = e;
+  child->parent = e->parent;
+  replace_child (tree, e, child);
+  child->right = e;
+  e->parent = child;
+}
+
+/* Makes NEW, which may be null, take OLD's place as a child of
+   OLD's parent, or as the root of TREE if OLD has no parent.
+   Does not update NEW's parent pointer. */
+static void
+replace_child (struct rb_tree *tree, struct rb_elem *old,
+               struct rb_elem *new) 
+{
+  if (old->parent == NULL)
+    tree->root = new;
+  else if (old == old->parent->left)
+    old->parent->left = new;
+  else
+    old->parent->right = new;
+}
+
+/* Returns the leftmost element in the subtree rooted at E. */
+static struct rb_elem *
+leftmost (struct rb_elem *e) 
+{
+  while (e->left != NULL)
+    e = e->left;
+  return e;
+}
+
+/* Returns the rightmost element in the subtree rooted at E. */
+static struct rb_elem *
+rightmost (struct rb_elem *e) 
+{
+  while (e->right != NULL)
+    e = e->right;
+  return e;
+}
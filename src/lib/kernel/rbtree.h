@@ -0,0 +1,117 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   An ordered container with O(log n) insertion, deletion, and
+   lookup, for cases where list_insert_ordered() would be too
+   slow.  Like the list and hash table implementations, it does
+   not require use of dynamically allocated memory.  Instead,
+   each structure that can potentially be in a tree must embed a
+   struct rb_elem member, and the rb_entry macro converts from a
+   struct rb_elem back to the structure object that contains it.
+
+   For example, a tree of `struct foo' ordered by `bar':
+
+      struct foo
+        {
+          struct rb_elem elem;
+          int bar;
+          ...other members...
+        };
+
+      static bool
+      foo_less (const struct rb_elem *a_, const struct rb_elem *b_,
+                void *aux UNUSED)
+      {
+        const struct foo *a = rb_entry (a_, struct foo, elem);
+        const struct foo *b = rb_entry (b_, struct foo, elem);
+        return a->bar < b->bar;
+      }
+
+      struct rb_tree foo_tree;
+
+      rb_init (&foo_tree, foo_less, NULL);
+
+   and iteration in order:
+
+      struct rb_elem *e;
+
+      for (e = rb_min (&foo_tree); e != NULL; e = rb_next (e))
+        {
+          struct foo *f = rb_entry (e, struct foo, elem);
+          ...do something with f...
+        }
+
+   A tree may hold several elements that compare equal.  A new
+   element is placed after any equal elements already in the
+   tree, so equal elements come out in the order they went in.
+
+   Lookups take a "key" element to compare against, which need
+   not be in the tree; typically it is a local variable of the
+   containing type with only the fields that LESS uses filled
+   in. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree element. */
+struct rb_elem 
+  {
+    struct rb_elem *parent;     /* Parent, or null for the root. */
+    struct rb_elem *left;       /* Left child, or null. */
+    struct rb_elem *right;      /* Right child, or null. */
+    bool red;                   /* Red or black? */
+  };
+
+/* Converts pointer to tree element RB_ELEM into a pointer to
+   the structure that RB_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the tree element.  See the big comment at the top of the
+   file for an example. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                       \
+        ((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent             \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree 
+  {
+    struct rb_elem *root;       /* Root, or null if tree empty. */
+    size_t elem_cnt;            /* Number of elements. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Initialization. */
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+
+/* Insertion and removal. */
+void rb_insert (struct rb_tree *, struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+
+/* Lookup. */
+struct rb_elem *rb_find (const struct rb_tree *, const struct rb_elem *key);
+struct rb_elem *rb_lower_bound (const struct rb_tree *,
+                                const struct rb_elem *key);
+struct rb_elem *rb_upper_bound (const struct rb_tree *,
+                                const struct rb_elem *key);
+
+/* Traversal. */
+struct rb_elem *rb_min (const struct rb_tree *);
+struct rb_elem *rb_max (const struct rb_tree *);
+struct rb_elem *rb_next (const struct rb_elem *);
+struct rb_elem *rb_prev (const struct rb_elem *);
+
+/* Properties. */
+size_t rb_size (const struct rb_tree *);
+bool rb_empty (const struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
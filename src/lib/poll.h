@@ -0,0 +1,26 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+/* Interface to the poll() system call, shared by the kernel and
+   user programs. */
+
+/* A descriptor to poll and the events of interest on it. */
+struct pollfd
+  {
+    int fd;                     /* Descriptor, or negative to skip. */
+    short events;               /* Events to wait for. */
+    short revents;              /* Events that occurred. */
+  };
+
+/* Events.  POLLERR, POLLHUP and POLLNVAL are reported whether or
+   not they are asked for. */
+#define POLLIN   0x001          /* Can read without blocking. */
+#define POLLOUT  0x004          /* Can write without blocking. */
+#define POLLERR  0x008          /* Write end with no readers left. */
+#define POLLHUP  0x010          /* Read end with no writers left. */
+#define POLLNVAL 0x020          /* Descriptor can't be polled. */
+
+/* Most descriptors that one poll() may examine. */
+#define POLL_MAX 64
+
+#endif /* lib/poll.h */
@@ -1,5 +1,24 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* memcpy(), memset(), memcmp() and strlen() work a 32-bit word
+   at a time once their operands are big enough to make it pay,
+   falling back to bytes for the unaligned head and the tail.
+   memcpy() and memset() move the words with "rep movsl" and
+   "rep stosl", which rely on the direction flag being clear, as
+   the i386 ABI and intr_entry both guarantee.  x86 tolerates
+   unaligned word accesses, so we align only the destination
+   (or, for strlen(), the string) and let the other side fall
+   where it may. */
+
+/* A machine word that may alias any other type. */
+typedef uint32_t word_t __attribute__ ((may_alias));
+
+/* Size of a word, and the minimum block size at which the word
+   versions are used. */
+#define WORD_SIZE sizeof (word_t)
+#define WORD_MIN 16
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,6 +31,22 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
+  if (size >= WORD_MIN)
+    {
+      size_t head = -(uintptr_t) dst & (WORD_SIZE - 1);
+      size_t words;
+
+      size -= head;
+      while (head-- > 0)
+        *dst++ = *src++;
+
+      words = size / WORD_SIZE;
+      size %= WORD_SIZE;
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words)
+                    : : "memory");
+    }
+
   while (size-- > 0)
     *dst++ = *src++;
 
@@ -58,6 +93,14 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip over equal words.  The first word that differs, if
+     any, is left for the byte loop to pick apart. */
+  if (size >= WORD_MIN)
+    for (; size >= WORD_SIZE; a += WORD_SIZE, b += WORD_SIZE,
+           size -= WORD_SIZE)
+      if (*(const word_t *) a != *(const word_t *) b)
+        break;
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -281,6 +324,24 @@ memset (void *dst_, int value, size_t size)
   unsigned char *dst = dst_;
 
   ASSERT (dst != NULL || size == 0);
+
+  if (size >= WORD_MIN)
+    {
+      size_t head = -(uintptr_t) dst & (WORD_SIZE - 1);
+      word_t pattern = (unsigned char) value * 0x01010101u;
+      size_t words;
+
+      size -= head;
+      while (head-- > 0)
+        *dst++ = value;
+
+      words = size / WORD_SIZE;
+      size %= WORD_SIZE;
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words)
+                    : "a" (pattern)
+                    : "memory");
+    }
   
   while (size-- > 0)
     *dst++ = value;
@@ -293,10 +354,24 @@ size_t
 strlen (const char *string) 
 {
   const char *p;
+  const word_t *w;
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
+  /* Check bytes up to a word boundary. */
+  for (p = string; (uintptr_t) p % WORD_SIZE != 0; p++)
+    if (*p == '\0')
+      return p - string;
+
+  /* Check a word at a time.  An aligned word never crosses a
+     page boundary, so reading past the terminator is safe.  The
+     test is nonzero exactly when some byte of *W is zero. */
+  for (w = (const word_t *) p;
+       ((*w - 0x01010101u) & ~*w & 0x80808080u) == 0; w++)
+    continue;
+
+  /* Find the null byte within the word. */
+  for (p = (const char *) w; *p != '\0'; p++)
     continue;
   return p - string;
 }
@@ -28,7 +28,25 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Debugging. */
+    SYS_SCHEDSTAT,              /* Print scheduler statistics. */
+
+    /* Process and IPC extensions. */
+    SYS_WAIT_ANY,               /* Wait for any child process to die. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_DUP2,                   /* Duplicate a file descriptor. */
+    SYS_SHM_OPEN,               /* Open a shared memory segment. */
+    SYS_SHM_MAP,                /* Map a shared memory segment. */
+    SYS_SHM_UNMAP,              /* Unmap a shared memory segment. */
+    SYS_THREAD_CREATE,          /* Start another thread. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_THREAD_EXIT,            /* End the calling thread. */
+    SYS_FUTEX_WAIT,             /* Sleep if a futex holds a value. */
+    SYS_FUTEX_WAKE,             /* Wake threads sleeping on a futex. */
+    SYS_FCNTL,                  /* Get or set descriptor flags. */
+    SYS_POLL                    /* Wait for descriptors to be ready. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,110 @@
+#include <synch.h>
+#include <syscall.h>
+
+/* If *P equals OLD, sets it to NEW, atomically.  Returns the
+   previous value of *P. */
+static inline int
+compare_exchange (int *p, int old, int new) 
+{
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "+a" (old), "+m" (*p) : "r" (new) : "memory");
+  return old;
+}
+
+/* Sets *P to NEW, atomically.  Returns the previous value. */
+static inline int
+exchange (int *p, int new) 
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Adds N to *P, atomically.  Returns the previous value. */
+static inline int
+fetch_add (int *p, int n) 
+{
+  asm volatile ("lock xaddl %0, %1" : "+r" (n), "+m" (*p) : : "memory");
+  return n;
+}
+
+/* Initializes SEMA to VALUE. */
+void
+sema_init (struct semaphore *sema, unsigned value) 
+{
+  sema->value = value;
+  sema->waiters = 0;
+}
+
+/* Waits for SEMA's value to become positive and then atomically
+   decrements it. */
+void
+sema_down (struct semaphore *sema) 
+{
+  for (;;) 
+    {
+      int value = sema->value;
+      if (value > 0) 
+        {
+          if (compare_exchange (&sema->value, value, value - 1) == value)
+            return;
+          continue;
+        }
+
+      /* Announce ourselves before sleeping, so that sema_up()
+         knows to wake us.  futex_wait() returns at once if an
+         up slipped in since we looked at the value. */
+      fetch_add (&sema->waiters, 1);
+      futex_wait (&sema->value, 0);
+      fetch_add (&sema->waiters, -1);
+    }
+}
+
+/* Increments SEMA's value and wakes up one thread of those
+   waiting for it, if any. */
+void
+sema_up (struct semaphore *sema) 
+{
+  fetch_add (&sema->value, 1);
+  if (sema->waiters > 0)
+    futex_wake (&sema->value, 1);
+}
+
+/* Initializes LOCK, which is not held by any thread. */
+void
+lock_init (struct lock *lock) 
+{
+  lock->state = 0;
+}
+
+/* Acquires LOCK, waiting until it is available if necessary.
+
+   The lock's state is 0 if it is free, 1 if it is held with
+   nobody waiting, and 2 if it is held and others may be waiting.
+   Only a thread that finds it held goes into the kernel, and it
+   marks the state 2 first so that the holder knows to wake it. */
+void
+lock_acquire (struct lock *lock) 
+{
+  int state = compare_exchange (&lock->state, 0, 1);
+  if (state == 0)
+    return;
+
+  if (state != 2)
+    state = exchange (&lock->state, 2);
+  while (state != 0) 
+    {
+      futex_wait (&lock->state, 2);
+      state = exchange (&lock->state, 2);
+    }
+}
+
+/* Releases LOCK, which the running thread must hold. */
+void
+lock_release (struct lock *lock) 
+{
+  if (fetch_add (&lock->state, -1) != 1) 
+    {
+      lock->state = 0;
+      futex_wake (&lock->state, 1);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+/* Synchronization between the threads of a process, made with
+   thread_create(), or between processes that share the objects
+   through shared memory.  Both are built on futexes, so they
+   enter the kernel only to sleep or to wake a sleeper. */
+
+/* A counting semaphore. */
+struct semaphore 
+  {
+    int value;                  /* Current value. */
+    int waiters;                /* Threads that may be sleeping. */
+  };
+
+void sema_init (struct semaphore *, unsigned value);
+void sema_down (struct semaphore *);
+void sema_up (struct semaphore *);
+
+/* A lock, which at most one thread may hold at a time.  Only the
+   thread that acquired it should release it, but unlike a kernel
+   lock that is not checked. */
+struct lock 
+  {
+    int state;                  /* 0: free, 1: held, 2: contended. */
+  };
+
+void lock_init (struct lock *);
+void lock_acquire (struct lock *);
+void lock_release (struct lock *);
+
+#endif /* lib/user/synch.h */
@@ -182,3 +182,96 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+void
+schedstat (void)
+{
+  syscall0 (SYS_SCHEDSTAT);
+}
+
+pid_t
+wait_any (int *status)
+{
+  return (pid_t) syscall1 (SYS_WAIT_ANY, status);
+}
+
+int
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+dup2 (int oldfd, int newfd)
+{
+  return syscall2 (SYS_DUP2, oldfd, newfd);
+}
+
+int
+shm_open (int key, unsigned size)
+{
+  return syscall2 (SYS_SHM_OPEN, key, size);
+}
+
+void *
+shm_map (int fd, void *addr)
+{
+  return (void *) syscall2 (SYS_SHM_MAP, fd, addr);
+}
+
+bool
+shm_unmap (void *addr)
+{
+  return syscall1 (SYS_SHM_UNMAP, addr);
+}
+
+/* Where a thread made by thread_create() starts. */
+static void
+thread_start (void (*function) (void *aux), void *aux) 
+{
+  function (aux);
+  thread_exit ();
+}
+
+tid_t
+thread_create (void (*function) (void *aux), void *aux)
+{
+  return syscall3 (SYS_THREAD_CREATE, thread_start, function, aux);
+}
+
+int
+thread_join (tid_t tid)
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (void)
+{
+  syscall0 (SYS_THREAD_EXIT);
+  NOT_REACHED ();
+}
+
+int
+futex_wait (int *addr, int expected)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, expected);
+}
+
+int
+futex_wake (int *addr, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+int
+fcntl (int fd, int cmd, int arg)
+{
+  return syscall3 (SYS_FCNTL, fd, cmd, arg);
+}
+
+int
+poll (struct pollfd *fds, unsigned nfds, int timeout)
+{
+  return syscall3 (SYS_POLL, fds, nfds, timeout);
+}
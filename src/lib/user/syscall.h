@@ -3,11 +3,17 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <fcntl.h>
+#include <poll.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier, for threads within a process. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -45,4 +51,26 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Debugging. */
+void schedstat (void);
+
+/* Process and IPC extensions. */
+pid_t wait_any (int *status);
+int pipe (int fds[2]);
+int dup2 (int oldfd, int newfd);
+int shm_open (int key, unsigned size);
+void *shm_map (int fd, void *addr);
+bool shm_unmap (void *addr);
+
+/* Threads.  See also <synch.h>. */
+tid_t thread_create (void (*function) (void *aux), void *aux);
+int thread_join (tid_t);
+void thread_exit (void) NO_RETURN;
+int futex_wait (int *addr, int expected);
+int futex_wake (int *addr, int cnt);
+
+/* Non-blocking I/O. */
+int fcntl (int fd, int cmd, int arg);
+int poll (struct pollfd *fds, unsigned nfds, int timeout);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,192 @@
+/* Test program for lib/kernel/ohash.c.
+
+   Grows a table, shrinks it, and grows it again right away,
+   while the shrink is still moving elements, checking after
+   every change that it holds exactly the elements it should and
+   that no resize had to finish the previous one all at once.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <ohash.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a table that we will test. */
+#define MAX_SIZE 1024
+
+/* Most slots of the old array that a single insertion or
+   deletion empties: MOVE_STEPS in ohash.c, times 5 right after a
+   shrink. */
+#define MAX_MOVE 20
+
+/* A table element. */
+struct value 
+  {
+    struct hash_elem elem;      /* Hash element. */
+    int key;                    /* Key. */
+    bool present;               /* In the table? */
+  };
+
+static struct value values[MAX_SIZE];
+static struct value *order[MAX_SIZE];
+
+static void shuffle (struct value *[], size_t);
+static void insert (struct ohash *, struct value *);
+static void delete (struct ohash *, struct value *);
+static void check_resize (const struct ohash *before,
+                          const struct ohash *after);
+static void verify_table (struct ohash *, size_t size);
+static unsigned value_hash (const struct hash_elem *, void *);
+static bool value_less (const struct hash_elem *, const struct hash_elem *,
+                        void *);
+
+/* Test the open-addressing hash table implementation. */
+void
+test (void) 
+{
+  struct ohash h;
+  size_t slot_cnt;
+  int i, deleted;
+
+  for (i = 0; i < MAX_SIZE; i++) 
+    {
+      values[i].key = i;
+      values[i].present = false;
+      order[i] = &values[i];
+    }
+  ASSERT (ohash_init (&h, value_hash, value_less, NULL));
+
+  printf ("testing grow:");
+  shuffle (order, MAX_SIZE);
+  for (i = 0; i < MAX_SIZE; i++)
+    insert (&h, order[i]);
+  verify_table (&h, MAX_SIZE);
+  printf (" done\n");
+
+  /* Delete elements until the first shrink starts. */
+  printf ("testing shrink:");
+  shuffle (order, MAX_SIZE);
+  slot_cnt = h.cur.slot_cnt;
+  for (deleted = 0; h.cur.slot_cnt >= slot_cnt; deleted++)
+    delete (&h, order[deleted]);
+  ASSERT (h.old.elem_cnt > 0);
+  verify_table (&h, MAX_SIZE - deleted);
+  printf (" done\n");
+
+  printf ("testing grow after shrink:");
+  for (i = 0; i < deleted; i++)
+    insert (&h, order[i]);
+  verify_table (&h, MAX_SIZE);
+  printf (" done\n");
+
+  printf ("testing removal of everything:");
+  shuffle (order, MAX_SIZE);
+  for (i = 0; i < MAX_SIZE; i++)
+    delete (&h, order[i]);
+  verify_table (&h, 0);
+  ASSERT (ohash_empty (&h));
+  printf (" done\n");
+
+  ohash_destroy (&h, NULL);
+  printf ("ohash: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void
+shuffle (struct value *array[], size_t cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      struct value *t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Inserts V, which must not be present, into H. */
+static void
+insert (struct ohash *h, struct value *v) 
+{
+  struct ohash before = *h;
+
+  ASSERT (!v->present);
+  ASSERT (ohash_insert (h, &v->elem) == NULL);
+  v->present = true;
+  check_resize (&before, h);
+}
+
+/* Deletes V, which must be present, from H. */
+static void
+delete (struct ohash *h, struct value *v) 
+{
+  struct ohash before = *h;
+
+  ASSERT (v->present);
+  ASSERT (ohash_delete (h, &v->elem) == &v->elem);
+  v->present = false;
+  check_resize (&before, h);
+}
+
+/* Checks that, if the operation that took a table from BEFORE to
+   AFTER started a resize, the previous resize was already all
+   but done, so the operation didn't have to rehash a whole slot
+   array. */
+static void
+check_resize (const struct ohash *before, const struct ohash *after) 
+{
+  ASSERT (after->cur.slots == before->cur.slots
+          || before->old.elem_cnt <= MAX_MOVE);
+}
+
+/* Verifies that H contains SIZE elements, exactly those values
+   marked present, and that iteration visits each of them once. */
+static void
+verify_table (struct ohash *h, size_t size) 
+{
+  struct ohash_iterator i;
+  size_t cnt;
+  int k;
+
+  ASSERT (ohash_size (h) == size);
+  for (k = 0; k < MAX_SIZE; k++) 
+    {
+      struct hash_elem *found = ohash_find (h, &values[k].elem);
+      ASSERT (found == (values[k].present ? &values[k].elem : NULL));
+    }
+
+  cnt = 0;
+  ohash_first (&i, h);
+  while (ohash_next (&i)) 
+    {
+      ASSERT (hash_entry (ohash_cur (&i), struct value, elem)->present);
+      cnt++;
+    }
+  ASSERT (cnt == size);
+}
+
+/* Returns a hash of value E's key. */
+static unsigned
+value_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  return hash_int (hash_entry (e, struct value, elem)->key);
+}
+
+/* Returns true if value A's key is less than value B's, false
+   otherwise. */
+static bool
+value_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct value *a = hash_entry (a_, struct value, elem);
+  const struct value *b = hash_entry (b_, struct value, elem);
+  
+  return a->key < b->key;
+}
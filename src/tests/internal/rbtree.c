@@ -0,0 +1,196 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Inserts and removes elements in random order, checking after
+   every change that the tree is ordered, satisfies the red-black
+   properties, and can find each of its elements.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <rbtree.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 64
+
+/* A tree element. */
+struct value 
+  {
+    struct rb_elem elem;        /* Tree element. */
+    int key;                    /* Sort key. */
+    int seq;                    /* Order of insertion among equal keys. */
+  };
+
+static void shuffle (struct value *[], size_t);
+static bool is_red (const struct rb_elem *);
+static bool value_less (const struct rb_elem *, const struct rb_elem *,
+                        void *);
+static int check_subtree (const struct rb_elem *);
+static void verify_tree (struct rb_tree *, struct value *[], int size);
+
+/* Test the red-black tree implementation. */
+void
+test (void) 
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 0; size < MAX_SIZE; size++) 
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++) 
+        {
+          static struct value values[MAX_SIZE];
+          static struct value *order[MAX_SIZE];
+          struct rb_tree tree;
+          int i;
+
+          /* Give pairs of values equal keys, to test that equal
+             elements stay in insertion order. */
+          for (i = 0; i < size; i++) 
+            {
+              values[i].key = i / 2;
+              order[i] = &values[i];
+            }
+
+          /* Insert the values in random order. */
+          rb_init (&tree, value_less, NULL);
+          shuffle (order, size);
+          for (i = 0; i < size; i++) 
+            {
+              order[i]->seq = i;
+              rb_insert (&tree, &order[i]->elem);
+              ASSERT (rb_size (&tree) == (size_t) i + 1);
+              check_subtree (tree.root);
+            }
+          verify_tree (&tree, order, size);
+
+          /* Remove them in a different random order. */
+          shuffle (order, size);
+          for (i = 0; i < size; i++) 
+            {
+              rb_remove (&tree, &order[i]->elem);
+              ASSERT (rb_size (&tree) == (size_t) (size - i - 1));
+              ASSERT (tree.root == NULL || tree.root->parent == NULL);
+              ASSERT (!is_red (tree.root));
+              check_subtree (tree.root);
+              verify_tree (&tree, order + i + 1, size - i - 1);
+            }
+          ASSERT (rb_empty (&tree));
+          ASSERT (rb_min (&tree) == NULL && rb_max (&tree) == NULL);
+        }
+    }
+  printf (" done\n");
+  printf ("rbtree: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void
+shuffle (struct value *array[], size_t cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      struct value *t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Returns true if value A's key is less than value B's, false
+   otherwise. */
+static bool
+value_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct value *a = rb_entry (a_, struct value, elem);
+  const struct value *b = rb_entry (b_, struct value, elem);
+  
+  return a->key < b->key;
+}
+
+/* Returns true if E is red, false if it is black or null. */
+static bool
+is_red (const struct rb_elem *e) 
+{
+  return e != NULL && e->red;
+}
+
+/* Checks that the subtree rooted at E has consistent parent
+   pointers and no red element with a red child, and that every
+   path from E to a leaf has the same number of black elements.
+   Returns that number. */
+static int
+check_subtree (const struct rb_elem *e) 
+{
+  int left_height, right_height;
+
+  if (e == NULL)
+    return 1;
+
+  ASSERT (e->left == NULL || e->left->parent == e);
+  ASSERT (e->right == NULL || e->right->parent == e);
+  if (e->red)
+    {
+      ASSERT (!is_red (e->left) && !is_red (e->right));
+    }
+
+  left_height = check_subtree (e->left);
+  right_height = check_subtree (e->right);
+  ASSERT (left_height == right_height);
+  return left_height + (e->red ? 0 : 1);
+}
+
+/* Verifies that TREE contains exactly the SIZE values in VALUES,
+   that traversal in either direction visits them in order with
+   equal keys in insertion order, and that lookups find them. */
+static void
+verify_tree (struct rb_tree *tree, struct value *values[], int size) 
+{
+  struct rb_elem *e, *prev;
+  int i, cnt;
+
+  /* Forward. */
+  for (cnt = 0, prev = NULL, e = rb_min (tree); e != NULL;
+       cnt++, prev = e, e = rb_next (e)) 
+    if (prev != NULL) 
+      {
+        struct value *p = rb_entry (prev, struct value, elem);
+        struct value *v = rb_entry (e, struct value, elem);
+        ASSERT (p->key < v->key || (p->key == v->key && p->seq < v->seq));
+        ASSERT (rb_prev (e) == prev);
+      }
+  ASSERT (cnt == size);
+  ASSERT (prev == rb_max (tree));
+
+  /* Lookups. */
+  for (i = 0; i < size; i++) 
+    {
+      struct value *v = values[i];
+      struct rb_elem *lower, *upper, *found;
+
+      found = rb_find (tree, &v->elem);
+      ASSERT (found != NULL
+              && rb_entry (found, struct value, elem)->key == v->key);
+
+      lower = rb_lower_bound (tree, &v->elem);
+      ASSERT (lower != NULL
+              && rb_entry (lower, struct value, elem)->key == v->key);
+      ASSERT (rb_prev (lower) == NULL
+              || rb_entry (rb_prev (lower), struct value, elem)->key < v->key);
+
+      upper = rb_upper_bound (tree, &v->elem);
+      ASSERT (upper == NULL
+              || rb_entry (upper, struct value, elem)->key > v->key);
+      ASSERT ((upper == NULL ? rb_max (tree) : rb_prev (upper)) != NULL);
+    }
+}
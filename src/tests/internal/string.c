@@ -0,0 +1,214 @@
+/* Test program and microbenchmark for the memory and string
+   functions in lib/string.c.
+
+   Checks memcpy(), memset(), memcmp() and strlen() against
+   simple byte-at-a-time reference versions at a range of sizes
+   and alignments, then times both versions with the CPU's cycle
+   counter and prints the average cycles per call.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+
+/* Size of the test buffers, and how much larger they are than
+   the largest block tested, to leave room for misalignment. */
+#define BUF_SIZE (4096 + 8)
+
+/* Number of times each timed call is repeated. */
+#define ITERATIONS 64
+
+/* Block sizes tested. */
+static const size_t sizes[] = {1, 7, 16, 64, 256, 1024, 4096};
+#define SIZE_CNT (sizeof sizes / sizeof *sizes)
+
+/* Misalignments tested, as (destination, source) offsets. */
+static const int aligns[][2] = {{0, 0}, {1, 1}, {0, 3}, {3, 1}};
+#define ALIGN_CNT (sizeof aligns / sizeof *aligns)
+
+static uint8_t buf_a[BUF_SIZE], buf_b[BUF_SIZE], buf_c[BUF_SIZE];
+
+/* Receives each timed call's result, so that the compiler
+   cannot discard calls to pure functions. */
+static volatile uintptr_t sink;
+
+static void *byte_memcpy (void *, const void *, size_t);
+static void *byte_memset (void *, int, size_t);
+static int byte_memcmp (const void *, const void *, size_t);
+static size_t byte_strlen (const char *);
+static void fill_random (uint8_t *, size_t);
+static void verify (size_t size, int dst_ofs, int src_ofs);
+static void benchmark (size_t size, int dst_ofs, int src_ofs);
+static uint64_t rdtsc (void);
+
+/* Tests and times the string functions. */
+void
+test (void) 
+{
+  size_t i, j;
+
+  printf ("testing string functions:");
+  for (i = 0; i < SIZE_CNT; i++)
+    for (j = 0; j < ALIGN_CNT; j++)
+      verify (sizes[i], aligns[j][0], aligns[j][1]);
+  printf (" done\n");
+
+  printf ("cycles per call, byte-at-a-time vs. lib/string.c:\n");
+  printf ("%5s %3s %3s %13s %13s %13s %13s\n", "size", "dst", "src",
+          "memcpy", "memset", "memcmp", "strlen");
+  for (i = 0; i < SIZE_CNT; i++)
+    for (j = 0; j < ALIGN_CNT; j++)
+      benchmark (sizes[i], aligns[j][0], aligns[j][1]);
+
+  printf ("string: PASS\n");
+}
+
+/* Checks each function on SIZE-byte blocks at offsets DST_OFS
+   and SRC_OFS into the buffers against its reference version. */
+static void
+verify (size_t size, int dst_ofs, int src_ofs) 
+{
+  uint8_t *dst = buf_b + dst_ofs;
+  uint8_t *src = buf_a + src_ofs;
+  size_t i;
+
+  /* memcpy(), including the bytes on either side. */
+  fill_random (buf_a, BUF_SIZE);
+  fill_random (buf_b, BUF_SIZE);
+  byte_memcpy (buf_c, buf_b, BUF_SIZE);
+  memcpy (dst, src, size);
+  byte_memcpy (buf_c + dst_ofs, src, size);
+  ASSERT (byte_memcmp (buf_b, buf_c, BUF_SIZE) == 0);
+
+  /* memset(). */
+  memset (dst, 0xa5, size);
+  byte_memset (buf_c + dst_ofs, 0xa5, size);
+  ASSERT (byte_memcmp (buf_b, buf_c, BUF_SIZE) == 0);
+
+  /* memcmp(), equal and with a difference at each position. */
+  memcpy (dst, src, size);
+  ASSERT (memcmp (dst, src, size) == 0);
+  for (i = 0; i < size; i++) 
+    {
+      dst[i]++;
+      ASSERT (memcmp (dst, src, size) == byte_memcmp (dst, src, size));
+      dst[i] -= 2;
+      ASSERT (memcmp (dst, src, size) == byte_memcmp (dst, src, size));
+      dst[i]++;
+    }
+
+  /* strlen(), with the terminator at the end. */
+  memset (dst, 'x', size);
+  dst[size - 1] = '\0';
+  ASSERT (strlen ((char *) dst) == size - 1);
+  ASSERT (strlen ((char *) dst) == byte_strlen ((char *) dst));
+}
+
+/* Times each function and its reference version on SIZE-byte
+   blocks at offsets DST_OFS and SRC_OFS into the buffers, and
+   prints a line of results. */
+static void
+benchmark (size_t size, int dst_ofs, int src_ofs) 
+{
+  uint8_t *dst = buf_b + dst_ofs;
+  uint8_t *src = buf_a + src_ofs;
+  uint64_t t[8];
+  int i;
+
+#define TIME(SLOT, CALL)                        \
+  do {                                          \
+    uint64_t start = rdtsc ();                  \
+    for (i = 0; i < ITERATIONS; i++)            \
+      sink = (uintptr_t) (CALL);                \
+    t[SLOT] = (rdtsc () - start) / ITERATIONS;  \
+  } while (0)
+
+  TIME (0, byte_memcpy (dst, src, size));
+  TIME (1, memcpy (dst, src, size));
+  TIME (2, byte_memset (dst, 0, size));
+  TIME (3, memset (dst, 0, size));
+  memcpy (dst, src, size);
+  TIME (4, byte_memcmp (dst, src, size));
+  TIME (5, memcmp (dst, src, size));
+  memset (dst, 'x', size);
+  dst[size - 1] = '\0';
+  TIME (6, byte_strlen ((char *) dst));
+  TIME (7, strlen ((char *) dst));
+#undef TIME
+
+  printf ("%5zu %3d %3d", size, dst_ofs, src_ofs);
+  for (i = 0; i < 8; i += 2)
+    printf (" %6llu/%-6llu", t[i], t[i + 1]);
+  printf ("\n");
+}
+
+/* Fills the SIZE bytes at P with random values. */
+static void
+fill_random (uint8_t *p, size_t size) 
+{
+  while (size-- > 0)
+    *p++ = random_ulong ();
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Reference memcpy(), one byte at a time. */
+static void *
+byte_memcpy (void *dst_, const void *src_, size_t size) 
+{
+  volatile unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+  return dst_;
+}
+
+/* Reference memset(), one byte at a time. */
+static void *
+byte_memset (void *dst_, int value, size_t size) 
+{
+  volatile unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+  return dst_;
+}
+
+/* Reference memcmp(), one byte at a time. */
+static int
+byte_memcmp (const void *a_, const void *b_, size_t size) 
+{
+  const volatile unsigned char *a = a_;
+  const volatile unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+/* Reference strlen(), one byte at a time. */
+static size_t
+byte_strlen (const char *string) 
+{
+  const volatile char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
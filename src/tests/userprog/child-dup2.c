@@ -0,0 +1,19 @@
+/* Child process run by dup2-exec test.
+
+   Writes a fixed message to its standard output, which its
+   parent has redirected into a pipe. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/userprog/child-dup2.h"
+
+int
+main (void) 
+{
+  test_name = "child-dup2";
+
+  write (STDOUT_FILENO, CHILD_DUP2_MSG, strlen (CHILD_DUP2_MSG));
+  return 0;
+}
@@ -0,0 +1,7 @@
+#ifndef TESTS_USERPROG_CHILD_DUP2_H
+#define TESTS_USERPROG_CHILD_DUP2_H
+
+/* What child-dup2 writes to its standard output. */
+#define CHILD_DUP2_MSG "written by child-dup2\n"
+
+#endif /* tests/userprog/child-dup2.h */
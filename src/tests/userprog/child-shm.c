@@ -0,0 +1,26 @@
+/* Child process run by shm-shared test.
+
+   Maps the shared memory segment that its parent created, checks
+   that it sees the parent's write, and writes a value of its
+   own for the parent to check. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/userprog/child-shm.h"
+
+int
+main (void) 
+{
+  int *shared;
+  int fd;
+
+  test_name = "child-shm";
+
+  msg ("begin");
+  CHECK ((fd = shm_open (SHM_KEY, SHM_SIZE)) > 1, "shm_open");
+  CHECK ((shared = shm_map (fd, (void *) 0x20000000)) != NULL, "shm_map");
+  CHECK (shared[0] == PARENT_MAGIC, "parent's write is visible");
+  shared[1] = CHILD_MAGIC;
+  msg ("end");
+  return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef TESTS_USERPROG_CHILD_SHM_H
+#define TESTS_USERPROG_CHILD_SHM_H
+
+/* Shared memory segment used by shm-shared and child-shm. */
+#define SHM_KEY 0x73686d        /* Segment key. */
+#define SHM_SIZE 4096           /* Segment size in bytes. */
+
+/* Values written by each process. */
+#define PARENT_MAGIC 0x12345678
+#define CHILD_MAGIC 0x0badcafe
+
+#endif /* tests/userprog/child-shm.h */
@@ -0,0 +1,40 @@
+/* Redirects standard output into a pipe with dup2(), then runs a
+   child process, which inherits the redirection and writes to
+   its standard output.  After restoring its own standard output,
+   the parent reads what the child wrote from the pipe. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/userprog/child-dup2.h"
+
+void
+test_main (void) 
+{
+  char buf[64];
+  int fds[2];
+  int total, n;
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (dup2 (fds[1], STDOUT_FILENO) == STDOUT_FILENO,
+         "redirect standard output");
+
+  /* Nothing we print reaches the console until we close our
+     redirected standard output. */
+  pid = exec ("child-dup2");
+  close (STDOUT_FILENO);
+  close (fds[1]);
+  if (pid == PID_ERROR)
+    fail ("exec \"child-dup2\"");
+  msg ("wait(exec()) = %d", wait (pid));
+
+  for (total = 0; (n = read (fds[0], buf + total, sizeof buf - total)) > 0; )
+    total += n;
+  CHECK (total == sizeof CHILD_DUP2_MSG - 1
+         && !memcmp (buf, CHILD_DUP2_MSG, total),
+         "read child's output from pipe");
+  close (fds[0]);
+}
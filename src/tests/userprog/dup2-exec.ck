@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dup2-exec) begin
+(dup2-exec) pipe
+(dup2-exec) redirect standard output
+child-dup2: exit(0)
+(dup2-exec) wait(exec()) = 0
+(dup2-exec) read child's output from pipe
+(dup2-exec) end
+dup2-exec: exit(0)
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Opens "sample.txt" twice, reads part of it through the first
+   descriptor, then makes the second a copy of the first with
+   dup2().  The copy must share the first descriptor's position,
+   so reading through it continues where the first left off. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  int fd1, fd2;
+
+  CHECK ((fd1 = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((fd2 = open ("sample.txt")) > 1, "open \"sample.txt\" again");
+  CHECK (read (fd1, buf, 10) == 10, "read 10 bytes");
+  CHECK (dup2 (fd1, fd2) == fd2, "dup2");
+  CHECK (tell (fd2) == 10, "tell copy");
+  CHECK (read (fd2, buf, 10) == 10
+         && !memcmp (buf, sample + 10, 10), "read copy at offset 10");
+  CHECK (tell (fd1) == 20, "tell original");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(dup2-offset) begin
+(dup2-offset) open "sample.txt"
+(dup2-offset) open "sample.txt" again
+(dup2-offset) read 10 bytes
+(dup2-offset) dup2
+(dup2-offset) tell copy
+(dup2-offset) read copy at offset 10
+(dup2-offset) tell original
+(dup2-offset) end
+dup2-offset: exit(0)
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Starts several threads that each increment a shared counter
+   many times, reading and writing it separately while holding a
+   lock built on futexes.  Timer interrupts preempt the threads
+   inside the critical section, so the lock is contended.  No
+   increment may be lost. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITERATIONS 2000
+
+static struct lock lock;
+static volatile int counter;
+
+static void
+increment (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      volatile int j;
+      int value;
+
+      lock_acquire (&lock);
+      value = counter;
+      for (j = 0; j < 100; j++)
+        continue;
+      counter = value + 1;
+      lock_release (&lock);
+    }
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  lock_init (&lock);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK ((tids[i] = thread_create (increment, NULL)) != TID_ERROR,
+           "thread_create %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == 0, "thread_join %d", i);
+  if (counter != THREAD_CNT * ITERATIONS)
+    fail ("counter is %d, not %d", counter, THREAD_CNT * ITERATIONS);
+  msg ("counter is %d", counter);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-lock) begin
+(futex-lock) thread_create 0
+(futex-lock) thread_create 1
+(futex-lock) thread_create 2
+(futex-lock) thread_create 3
+(futex-lock) thread_join 0
+(futex-lock) thread_join 1
+(futex-lock) thread_join 2
+(futex-lock) thread_join 3
+(futex-lock) counter is 8000
+(futex-lock) end
+futex-lock: exit(0)
+EOF
+pass;
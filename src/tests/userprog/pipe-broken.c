@@ -0,0 +1,17 @@
+/* Closes the read end of a pipe, then writes to its write end,
+   which must fail instead of waiting for a reader. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  close (fds[0]);
+  CHECK (write (fds[1], "x", 1) == -1, "write with no reader fails");
+  close (fds[1]);
+}
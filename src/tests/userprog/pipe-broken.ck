@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-broken) begin
+(pipe-broken) pipe
+(pipe-broken) write with no reader fails
+(pipe-broken) end
+pipe-broken: exit(0)
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Writes to a pipe and closes its write end, then reads from the
+   read end, which must return the data and then end of file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char data[] = "through the pipe";
+  char buf[64];
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (write (fds[1], data, sizeof data) == (int) sizeof data,
+         "write %zu bytes", sizeof data);
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == (int) sizeof data,
+         "read %zu bytes", sizeof data);
+  if (memcmp (buf, data, sizeof data))
+    fail ("read data differs from written data");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read at end of file");
+  close (fds[0]);
+}
@@ -0,0 +1,41 @@
+/* Polls both ends of a pipe.  The write end must be ready at
+   once.  Then waits, with no timeout, for the read end to become
+   readable, which happens when another thread writes to the
+   pipe. */
+
+#include <poll.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int fds[2];
+
+static void
+writer (void *aux UNUSED) 
+{
+  write (fds[1], "x", 1);
+}
+
+void
+test_main (void) 
+{
+  struct pollfd pfds[2];
+  tid_t tid;
+  char c;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  pfds[0].fd = fds[0];
+  pfds[0].events = POLLIN;
+  pfds[1].fd = fds[1];
+  pfds[1].events = POLLOUT;
+  CHECK (poll (pfds, 2, 0) == 1 && pfds[0].revents == 0
+         && pfds[1].revents == POLLOUT, "write end is ready");
+
+  CHECK ((tid = thread_create (writer, NULL)) != TID_ERROR, "thread_create");
+  CHECK (poll (pfds, 1, -1) == 1 && pfds[0].revents == POLLIN,
+         "read end becomes ready");
+  CHECK (read (fds[0], &c, 1) == 1 && c == 'x', "read");
+  CHECK (thread_join (tid) == 0, "thread_join");
+  close (fds[0]);
+  close (fds[1]);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll-ready) begin
+(poll-ready) pipe
+(poll-ready) write end is ready
+(poll-ready) thread_create
+(poll-ready) read end becomes ready
+(poll-ready) read
+(poll-ready) thread_join
+(poll-ready) end
+poll-ready: exit(0)
+EOF
+pass;
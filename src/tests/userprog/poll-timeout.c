@@ -0,0 +1,24 @@
+/* Polls the read end of an empty pipe, first without waiting and
+   then with a timeout.  Both must return 0, with no events. */
+
+#include <poll.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct pollfd pfd;
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  pfd.fd = fds[0];
+  pfd.events = POLLIN;
+  CHECK (poll (&pfd, 1, 0) == 0 && pfd.revents == 0,
+         "poll without waiting");
+  CHECK (poll (&pfd, 1, 100) == 0 && pfd.revents == 0,
+         "poll with 100 ms timeout");
+  close (fds[0]);
+  close (fds[1]);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll-timeout) begin
+(poll-timeout) pipe
+(poll-timeout) poll without waiting
+(poll-timeout) poll with 100 ms timeout
+(poll-timeout) end
+poll-timeout: exit(0)
+EOF
+pass;
@@ -0,0 +1,23 @@
+/* Creates a shared memory segment and maps it, then runs a child
+   process that maps the same segment by key, at a different
+   address.  Each process must see what the other wrote. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/userprog/child-shm.h"
+
+void
+test_main (void) 
+{
+  int *shared;
+  int fd;
+
+  CHECK ((fd = shm_open (SHM_KEY, SHM_SIZE)) > 1, "shm_open");
+  CHECK ((shared = shm_map (fd, (void *) 0x10000000)) != NULL, "shm_map");
+  shared[0] = PARENT_MAGIC;
+  msg ("wait(exec()) = %d", wait (exec ("child-shm")));
+  CHECK (shared[1] == CHILD_MAGIC, "child's write is visible");
+  CHECK (shm_unmap (shared), "shm_unmap");
+  close (fd);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-shared) begin
+(shm-shared) shm_open
+(shm-shared) shm_map
+(child-shm) begin
+(child-shm) shm_open
+(child-shm) shm_map
+(child-shm) parent's write is visible
+(child-shm) end
+child-shm: exit(0)
+(shm-shared) wait(exec()) = 0
+(shm-shared) child's write is visible
+(shm-shared) shm_unmap
+(shm-shared) end
+shm-shared: exit(0)
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Starts a thread that calls exit() while the main thread is
+   blocked reading from an empty pipe.  The whole process must
+   exit with the status that thread passed, instead of hanging
+   on the main thread. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+exit_process (void *aux UNUSED) 
+{
+  exit (57);
+}
+
+void
+test_main (void) 
+{
+  int fds[2];
+  char c;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (thread_create (exit_process, NULL) != TID_ERROR, "thread_create");
+  read (fds[0], &c, 1);
+  fail ("read from empty pipe returned");
+}
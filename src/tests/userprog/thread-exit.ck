@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-exit) begin
+(thread-exit) pipe
+(thread-exit) thread_create
+thread-exit: exit(57)
+EOF
+pass;
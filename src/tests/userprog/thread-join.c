@@ -0,0 +1,35 @@
+/* Starts several threads in this process, each of which stores
+   a result where the main thread can see it, and joins them.
+   Joining a thread a second time must fail. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+
+static int results[THREAD_CNT];
+
+static void
+square (void *aux) 
+{
+  int i = (int) aux;
+  results[i] = i * i;
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK ((tids[i] = thread_create (square, (void *) i)) != TID_ERROR,
+           "thread_create %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == 0, "thread_join %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    if (results[i] != i * i)
+      fail ("thread %d stored %d, not %d", i, results[i], i * i);
+  CHECK (thread_join (tids[0]) == -1, "thread_join again fails");
+}
@@ -0,0 +1,54 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdint.h>
+#include "threads/flags.h"
+
+/* Feature bits returned by CPUID function 1 in EDX.
+   See [IA32-v2a] "CPUID". */
+#define CPUID_PSE 0x00000008    /* 4 MB pages. */
+#define CPUID_PGE 0x00002000    /* Global pages. */
+
+/* CR4 bits.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE 0x00000010      /* Page Size Extensions. */
+#define CR4_PGE 0x00000080      /* Page Global Enable. */
+
+/* Returns the CPUID function 1 feature flags (EDX), or 0 on a
+   CPU too old to have the CPUID instruction. */
+static inline uint32_t
+cpu_features (void)
+{
+  uint32_t flags, orig_flags;
+  uint32_t eax, ebx, ecx, edx;
+
+  /* The CPU has CPUID if and only if the ID flag in EFLAGS can
+     be changed. */
+  asm volatile ("pushfl; popl %0; movl %0, %1; xorl %2, %0; "
+                "pushl %0; popfl; pushfl; popl %0; pushl %1; popfl"
+                : "=&r" (flags), "=&r" (orig_flags) : "i" (FLAG_ID));
+  if (((flags ^ orig_flags) & FLAG_ID) == 0)
+    return 0;
+
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  return edx;
+}
+
+/* Returns the contents of CR4. */
+static inline uint32_t
+cpu_read_cr4 (void)
+{
+  uint32_t cr4;
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  return cr4;
+}
+
+/* Stores CR4 into the CR4 register. */
+static inline void
+cpu_write_cr4 (uint32_t cr4)
+{
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4) : "memory");
+}
+
+#endif /* threads/cpu.h */
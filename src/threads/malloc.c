@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,7 +33,37 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of each descriptor's free list sits a "magazine", a
+   small stack of free blocks in the style of a per-CPU cache.
+   Pintos has only one CPU, so the magazine is protected by
+   briefly disabling interrupts instead of by the descriptor's
+   lock, and most malloc() and free() calls never touch the lock
+   or the arenas at all.  When the magazine runs dry, malloc()
+   refills half of it from the free list in one locked batch;
+   when it fills up, free() flushes half of it back the same
+   way.  Blocks in a magazine count as in use as far as their
+   arenas are concerned.
+
+   Finally, an arena that becomes entirely unused is not given
+   back to the page allocator right away: each descriptor keeps
+   up to MAX_EMPTY_ARENAS of them around, so that a loop that
+   repeatedly allocates and frees a block does not allocate and
+   free a page every time. */
+
+/* Number of blocks a magazine holds. */
+#define MAG_SIZE 16
+
+/* Number of entirely free arenas each descriptor may keep. */
+#define MAX_EMPTY_ARENAS 2
+
+/* Magazine of free blocks. */
+struct magazine
+  {
+    size_t cnt;                 /* Number of blocks in BLOCKS. */
+    struct block *blocks[MAG_SIZE]; /* Free blocks. */
+  };
 
 /* Descriptor. */
 struct desc
@@ -40,7 +71,9 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t empty_arenas;        /* Number of entirely free arenas. */
     struct lock lock;           /* Lock. */
+    struct magazine mag;        /* Cache of free blocks, not on FREE_LIST. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -66,6 +99,8 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *take_block (struct desc *);
+static void return_block (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,7 +115,9 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
+      d->empty_arenas = 0;
       lock_init (&d->lock);
+      d->mag.cnt = 0;
     }
 }
 
@@ -92,6 +129,9 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  struct block *refill[MAG_SIZE / 2];
+  size_t refill_cnt;
+  enum intr_level old_level;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -119,6 +159,16 @@ malloc (size_t size)
       return a + 1;
     }
 
+  /* Take a block from the magazine, if it has one. */
+  old_level = intr_disable ();
+  if (d->mag.cnt > 0)
+    {
+      b = d->mag.blocks[--d->mag.cnt];
+      intr_set_level (old_level);
+      return b;
+    }
+  intr_set_level (old_level);
+
   lock_acquire (&d->lock);
 
   /* If the free list is empty, create a new arena. */
@@ -138,6 +188,7 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
+      d->empty_arenas++;
       for (i = 0; i < d->blocks_per_arena; i++) 
         {
           struct block *b = arena_to_block (a, i);
@@ -145,10 +196,26 @@ malloc (size_t size)
         }
     }
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  /* Get a block from free list to return, and up to half a
+     magazine's worth more to refill the magazine with. */
+  b = take_block (d);
+  for (refill_cnt = 0; refill_cnt < MAG_SIZE / 2; refill_cnt++)
+    {
+      if (list_empty (&d->free_list))
+        break;
+      refill[refill_cnt] = take_block (d);
+    }
+
+  /* Load the magazine.  A concurrent free() may have put blocks
+     into it since we looked, so anything that no longer fits
+     goes back to the free list. */
+  old_level = intr_disable ();
+  while (refill_cnt > 0 && d->mag.cnt < MAG_SIZE)
+    d->mag.blocks[d->mag.cnt++] = refill[--refill_cnt];
+  intr_set_level (old_level);
+  while (refill_cnt > 0)
+    return_block (d, refill[--refill_cnt]);
+
   lock_release (&d->lock);
   return b;
 }
@@ -228,30 +295,35 @@ free (void *p)
         {
           /* It's a normal block.  We handle it here. */
 
+          struct block *flush[MAG_SIZE / 2];
+          size_t flush_cnt = 0;
+          enum intr_level old_level;
+
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
 
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Put the block in the magazine, if there's room. */
+          old_level = intr_disable ();
+          if (d->mag.cnt < MAG_SIZE)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              d->mag.blocks[d->mag.cnt++] = b;
+              intr_set_level (old_level);
+              return;
             }
+          intr_set_level (old_level);
 
+          /* The magazine is full.  Flush half of it, and the block,
+             back to the free list. */
+          lock_acquire (&d->lock);
+          old_level = intr_disable ();
+          while (flush_cnt < MAG_SIZE / 2 && d->mag.cnt > 0)
+            flush[flush_cnt++] = d->mag.blocks[--d->mag.cnt];
+          intr_set_level (old_level);
+          while (flush_cnt > 0)
+            return_block (d, flush[--flush_cnt]);
+          return_block (d, b);
           lock_release (&d->lock);
         }
       else
@@ -263,6 +335,54 @@ free (void *p)
     }
 }
 
+/* Removes a block from D's free list and returns it.  D's lock
+   must be held and its free list must not be empty. */
+static struct block *
+take_block (struct desc *d)
+{
+  struct block *b;
+  struct arena *a;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_arenas--;
+  return b;
+}
+
+/* Adds block B to D's free list.  If that leaves B's arena
+   entirely unused and D already has MAX_EMPTY_ARENAS unused
+   arenas, gives the arena back to the page allocator.  D's lock
+   must be held. */
+static void
+return_block (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  list_push_front (&d->free_list, &b->free_elem);
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      if (d->empty_arenas < MAX_EMPTY_ARENAS)
+        d->empty_arenas++;
+      else
+        {
+          size_t i;
+
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct block *b = arena_to_block (a, i);
+              list_remove (&b->free_elem);
+            }
+          palloc_free_page (a);
+        }
+    }
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -1,14 +1,14 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +23,60 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
 
-/* A memory pool. */
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept as blocks of 2**ORDER pages, each aligned (relative to the
+   pool base) to its own size, on one free list per order.  A
+   request for N pages takes the smallest free block of at least
+   N pages, splits it in halves until it is just big enough, and
+   gives any pages beyond N back as smaller free blocks, so that
+   no memory is wasted on rounding.  Freeing a range breaks it
+   into aligned blocks and merges each with its "buddy" (the
+   other half of the block of the next larger order) for as long
+   as the buddy is also free.  Both operations take O(log n)
+   time in the size of the pool. */
+
+/* Tag in block_tags[] marking the first page of a free block.
+   The low bits hold the block's order. */
+#define BLOCK_FREE 0x80
+
+/* A free block.  Its list element lives in the block's first
+   page, which is otherwise unused. */
+struct free_block
+  {
+    struct list_elem elem;              /* Element in a free list. */
+  };
+
+/* A memory pool.
+
+   Pools are protected by disabling interrupts rather than by a
+   lock, because thread_schedule_tail() frees the page of a dying
+   thread with interrupts off, where it must not sleep.  Every
+   operation on the free lists takes only O(log n) time, so
+   interrupts are not off for long. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *block_tags;                /* Per-page free block tags. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    struct list free_lists[PALLOC_MAX_ORDER + 1]; /* Free blocks by order. */
+    size_t free_cnt[PALLOC_MAX_ORDER + 1];        /* # of free blocks. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Called when an allocation is about to fail, to give back pages
+   that are only waiting to be freed.  See palloc_set_reclaim(). */
+static palloc_reclaim_func *reclaim;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *page_pool (void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -73,15 +111,25 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
   size_t page_idx;
+  enum intr_level old_level;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+  page_idx = alloc_pages (pool, page_cnt);
+  intr_set_level (old_level);
+
+  if (page_idx == SIZE_MAX && reclaim != NULL
+      && !intr_context () && old_level == INTR_ON)
+    {
+      reclaim ();
+      old_level = intr_disable ();
+      page_idx = alloc_pages (pool, page_cnt);
+      intr_set_level (old_level);
+    }
 
-  if (page_idx != BITMAP_ERROR)
+  if (page_idx != SIZE_MAX)
     pages = pool->base + PGSIZE * page_idx;
   else
     pages = NULL;
@@ -119,26 +167,23 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
+  pool = page_pool (pages);
   page_idx = pg_no (pages) - pg_no (pool->base);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
+  old_level = intr_disable ();
+  free_pages (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +193,107 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Frees the PAGE_CNT single pages whose addresses are in PAGES.
+   The pages need not be contiguous or from the same pool.  This
+   is cheaper than palloc_free_page() on each one because the
+   free lists are updated in a single critical section. */
+void
+palloc_free_pages (void **pages, size_t page_cnt) 
+{
+  enum intr_level old_level;
+  size_t i;
+
+#ifndef NDEBUG
+  for (i = 0; i < page_cnt; i++)
+    memset (pages[i], 0xcc, PGSIZE);
+#endif
+
+  old_level = intr_disable ();
+  for (i = 0; i < page_cnt; i++) 
+    {
+      struct pool *pool = page_pool (pages[i]);
+
+      ASSERT (pg_ofs (pages[i]) == 0);
+      free_pages (pool, pg_no (pages[i]) - pg_no (pool->base), 1);
+    }
+  intr_set_level (old_level);
+}
+
+/* Sets FUNC as the function to call, from a kernel thread with
+   interrupts on, when an allocation finds too few free pages.
+   FUNC should free any pages that are only waiting to be freed
+   and may sleep.  The allocation is then retried once. */
+void
+palloc_set_reclaim (palloc_reclaim_func *func) 
+{
+  reclaim = func;
+}
+
+/* Returns the number of free blocks of 2**ORDER pages in the
+   user pool if PAL_USER is set in FLAGS, otherwise in the kernel
+   pool. */
+size_t
+palloc_free_block_cnt (enum palloc_flags flags, unsigned order)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+  ASSERT (order <= PALLOC_MAX_ORDER);
+  return pool->free_cnt[order];
+}
+
+/* Prints the number of free blocks of each order in POOL,
+   up to the largest order that has any. */
+static void
+print_pool_stats (const struct pool *pool, const char *name)
+{
+  int max_order, order;
+
+  for (max_order = PALLOC_MAX_ORDER; max_order > 0; max_order--)
+    if (pool->free_cnt[max_order] > 0)
+      break;
+
+  printf ("Palloc: %s free blocks by order:", name);
+  for (order = 0; order <= max_order; order++)
+    printf (" %zu", pool->free_cnt[order]);
+  printf ("\n");
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool, "kernel pool");
+  print_pool_stats (&user_pool, "user pool");
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's block tags at its base.
+     Calculate the space needed for the tags
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t tag_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+
+  if (tag_pages > page_cnt)
+    PANIC ("Not enough memory in %s for block tags.", name);
+  page_cnt -= tag_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  /* Initialize the pool, then free all of its pages. */
+  p->block_tags = base;
+  memset (p->block_tags, 0, page_cnt);
+  p->base = base + tag_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  for (order = 0; order <= PALLOC_MAX_ORDER; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+  free_pages (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +303,132 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the pool that PAGE was allocated from. */
+static struct pool *
+page_pool (void *page) 
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  else
+    NOT_REACHED ();
+}
+
+/* Returns the free block that starts at page PAGE_IDX in POOL. */
+static struct free_block *
+idx_to_block (const struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Adds the block of 2**ORDER pages starting at PAGE_IDX to
+   POOL's free lists. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->block_tags[page_idx] = BLOCK_FREE | order;
+  list_push_front (&pool->free_lists[order],
+                   &idx_to_block (pool, page_idx)->elem);
+  pool->free_cnt[order]++;
+}
+
+/* Removes the free block of 2**ORDER pages starting at PAGE_IDX
+   from POOL's free lists. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->block_tags[page_idx] == (BLOCK_FREE | order));
+
+  pool->block_tags[page_idx] = 0;
+  list_remove (&idx_to_block (pool, page_idx)->elem);
+  pool->free_cnt[order]--;
+}
+
+/* Frees the block of 2**ORDER pages starting at PAGE_IDX in
+   POOL, merging it with its buddy, and the resulting block with
+   its own buddy, and so on, for as long as the buddy is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (!(pool->block_tags[page_idx] & BLOCK_FREE));
+
+  for (; order < PALLOC_MAX_ORDER; order++)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx + ((size_t) 1 << order) > pool->page_cnt
+          || pool->block_tags[buddy_idx] != (BLOCK_FREE | order))
+        break;
+      remove_block (pool, buddy_idx, order);
+      page_idx &= ~((size_t) 1 << order);
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, by
+   breaking them into the largest blocks that are aligned to
+   their own size. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      /* Largest order allowed by both alignment and size. */
+      int order = 31 - __builtin_clz (page_cnt);
+      if (page_idx != 0 && __builtin_ctz (page_idx) < order)
+        order = __builtin_ctz (page_idx);
+      if (order > PALLOC_MAX_ORDER)
+        order = PALLOC_MAX_ORDER;
+
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or SIZE_MAX if no free block is big
+   enough. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt)
+{
+  int want, order;
+  size_t page_idx;
+
+  ASSERT (page_cnt > 0);
+
+  /* Smallest order that holds PAGE_CNT pages. */
+  want = page_cnt > 1 ? 32 - __builtin_clz (page_cnt - 1) : 0;
+  if (want > PALLOC_MAX_ORDER)
+    return SIZE_MAX;
+
+  /* Find the smallest free block that is big enough. */
+  for (order = want; order <= PALLOC_MAX_ORDER; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order > PALLOC_MAX_ORDER)
+    return SIZE_MAX;
+
+  page_idx = ((uint8_t *) list_entry (list_front (&pool->free_lists[order]),
+                                      struct free_block, elem)
+              - pool->base) / PGSIZE;
+  remove_block (pool, page_idx, order);
+
+  /* Split it down to the order we want, freeing the upper half
+     each time. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+
+  /* Give back the pages beyond PAGE_CNT. */
+  free_pages (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+
+  return page_idx;
+}
@@ -3,6 +3,10 @@
 
 #include <stddef.h>
 
+/* Largest block order managed by the buddy allocator: blocks
+   range in size from 1 to 2**PALLOC_MAX_ORDER pages. */
+#define PALLOC_MAX_ORDER 20
+
 /* How to allocate pages. */
 enum palloc_flags
   {
@@ -16,5 +20,12 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_free_pages (void **, size_t page_cnt);
+
+/* Frees pages that are only waiting to be freed. */
+typedef void palloc_reclaim_func (void);
+void palloc_set_reclaim (palloc_reclaim_func *);
+size_t palloc_free_block_cnt (enum palloc_flags, unsigned order);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,296 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Typed object caches, after Bonwick's slab allocator.
+
+   malloc() rounds each request up to a power of 2, so a 40-byte
+   object occupies a 64-byte block and a 540-byte inode occupies
+   a 1 kB block.  A cache instead serves objects of one exact
+   size, rounded up only to OBJ_ALIGN.  Each cache obtains pages,
+   called "slabs", from the page allocator and packs as many
+   objects into each one as will fit after the slab's header.
+
+   The header holds a stack of the indexes of the slab's free
+   objects, rather than threading a free list through the objects
+   themselves, so that a free object keeps whatever state its
+   constructor gave it.  The constructor therefore runs only when
+   a slab is created, not on every allocation.
+
+   A cache keeps its slabs on three lists: full, partially used,
+   and empty.  Allocation prefers partially used slabs, to keep
+   memory compact.  Up to MAX_EMPTY_SLABS empty slabs are kept
+   around to absorb bursts; beyond that, a slab that becomes
+   empty is given back to the page allocator. */
+
+/* Alignment of objects within a slab. */
+#define OBJ_ALIGN sizeof (void *)
+
+/* Number of empty slabs each cache may keep. */
+#define MAX_EMPTY_SLABS 1
+
+/* Maximum number of caches. */
+#define CACHE_CNT 32
+
+/* Object cache. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size requested by the creator. */
+    size_t stride;              /* Distance between objects in a slab. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t objs_ofs;            /* Offset of first object in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or a null pointer. */
+    struct lock lock;           /* Protects all of the below. */
+    struct list partial_slabs;  /* Slabs with some free objects. */
+    struct list full_slabs;     /* Slabs with no free objects. */
+    struct list empty_slabs;    /* Slabs with only free objects. */
+    size_t empty_cnt;           /* Number of slabs in EMPTY_SLABS. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Number of slabs. */
+    size_t active_cnt;          /* Number of allocated objects. */
+    unsigned long long alloc_cnt; /* Number of allocations. */
+    unsigned long long free_cnt;  /* Number of frees. */
+    unsigned long long fail_cnt;  /* Number of failed allocations. */
+  };
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x5ab1e5ab
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    size_t free_cnt;            /* Number of entries in FREE_IDX. */
+    uint16_t free_idx[];        /* Indexes of free objects. */
+  };
+
+/* All caches. */
+static struct kmem_cache caches[CACHE_CNT];
+static size_t cache_cnt;
+
+static struct slab *new_slab (struct kmem_cache *);
+static uint8_t *slab_obj (struct kmem_cache *, struct slab *, size_t idx);
+
+/* Creates and returns a cache of SIZE-byte objects, named NAME
+   for statistics.  If CTOR is nonnull, it is called on each
+   object when the slab holding it is created.  Panics if too
+   many caches have been created.
+
+   NAME must remain valid for as long as the kernel runs.  SIZE
+   must be small enough that at least one object fits in a
+   slab. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+  size_t n;
+
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  old_level = intr_disable ();
+  if (cache_cnt >= CACHE_CNT)
+    PANIC ("too many kmem caches creating \"%s\"", name);
+  c = &caches[cache_cnt++];
+  intr_set_level (old_level);
+
+  c->name = name;
+  c->obj_size = size;
+  c->stride = ROUND_UP (size, OBJ_ALIGN);
+  c->ctor = ctor;
+
+  /* Fit as many objects into a page as we can, along with the
+     header and one free index per object. */
+  n = (PGSIZE - sizeof (struct slab)) / (c->stride + sizeof (uint16_t));
+  while (n > 0
+         && (ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t), OBJ_ALIGN)
+             + n * c->stride) > PGSIZE)
+    n--;
+  ASSERT (n > 0);
+  c->objs_per_slab = n;
+  c->objs_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                          OBJ_ALIGN);
+
+  lock_init (&c->lock);
+  list_init (&c->partial_slabs);
+  list_init (&c->full_slabs);
+  list_init (&c->empty_slabs);
+  c->empty_cnt = 0;
+  c->slab_cnt = 0;
+  c->active_cnt = 0;
+  c->alloc_cnt = c->free_cnt = c->fail_cnt = 0;
+  return c;
+}
+
+/* Allocates and returns an object from cache C, or a null
+   pointer if no memory is available.  The object is in the
+   state its constructor left it in, or that it was freed in;
+   otherwise its contents are unspecified. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+
+  if (!list_empty (&c->partial_slabs))
+    s = list_entry (list_front (&c->partial_slabs), struct slab, elem);
+  else
+    {
+      if (!list_empty (&c->empty_slabs))
+        {
+          s = list_entry (list_pop_front (&c->empty_slabs),
+                          struct slab, elem);
+          c->empty_cnt--;
+        }
+      else
+        {
+          s = new_slab (c);
+          if (s == NULL)
+            {
+              c->fail_cnt++;
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial_slabs, &s->elem);
+    }
+
+  obj = slab_obj (c, s, s->free_idx[--s->free_cnt]);
+  if (s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full_slabs, &s->elem);
+    }
+  c->active_cnt++;
+  c->alloc_cnt++;
+
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Frees OBJ, which must have been allocated from cache C.  Does
+   nothing if OBJ is a null pointer. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t ofs;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ofs = pg_ofs (obj) - c->objs_ofs;
+  ASSERT (pg_ofs (obj) >= c->objs_ofs && ofs % c->stride == 0);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has constructed state to preserve. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  if (s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial_slabs, &s->elem);
+    }
+  s->free_idx[s->free_cnt++] = ofs / c->stride;
+  c->active_cnt--;
+  c->free_cnt++;
+
+  /* If the slab is now entirely unused, keep it or free it. */
+  if (s->free_cnt == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      if (c->empty_cnt < MAX_EMPTY_SLABS)
+        {
+          list_push_front (&c->empty_slabs, &s->elem);
+          c->empty_cnt++;
+        }
+      else
+        {
+          s->magic = 0;
+          palloc_free_page (s);
+          c->slab_cnt--;
+        }
+    }
+
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for each cache. */
+void
+kmem_cache_print_stats (void)
+{
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++)
+    {
+      struct kmem_cache *c = &caches[i];
+      printf ("Kmem: %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu active, %llu allocs, %llu frees, %llu failures\n",
+              c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+              c->active_cnt, c->alloc_cnt, c->free_cnt, c->fail_cnt);
+    }
+}
+
+/* Obtains a page for cache C, sets it up as a slab with all of
+   its objects free and constructed, and returns it.  Returns a
+   null pointer if no page is available.  C's lock must be
+   held. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+
+  /* Stack the indexes so that objects are handed out in address
+     order. */
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      s->free_idx[i] = c->objs_per_slab - i - 1;
+      if (c->ctor != NULL)
+        c->ctor (slab_obj (c, s, i));
+    }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns object IDX within slab S of cache C. */
+static uint8_t *
+slab_obj (struct kmem_cache *c, struct slab *s, size_t idx)
+{
+  ASSERT (idx < c->objs_per_slab);
+  return (uint8_t *) s + c->objs_ofs + idx * c->stride;
+}
@@ -41,6 +41,28 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Wait queue.  An object that a thread may want to wait on
+   together with others, as in poll(), keeps one; the waiting
+   thread adds an entry to each object's queue that ups one
+   semaphore of its own, and sleeps on that.  Safe to use from
+   interrupt handlers. */
+struct wait_queue 
+  {
+    struct list entries;        /* List of struct wait_entry. */
+  };
+
+struct wait_entry 
+  {
+    struct semaphore *sema;     /* To up, or null if not queued. */
+    struct list_elem elem;      /* Element in wait_queue. */
+  };
+
+void wait_queue_init (struct wait_queue *);
+void wait_queue_add (struct wait_queue *, struct wait_entry *,
+                     struct semaphore *);
+void wait_queue_remove (struct wait_entry *);
+void wait_queue_wake (struct wait_queue *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
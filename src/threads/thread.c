@@ -11,6 +11,7 @@
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
@@ -21,9 +22,21 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Number of distinct priority levels. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+
+/* Run queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO queue per priority level.
+
+   Bit I of ready_mask is set if and only if the queue for
+   priority PRI_MAX - I is nonempty, so that the lowest set bit
+   always names the highest-priority ready thread's queue.  The
+   mask is split into two 32-bit words because the find-first-set
+   instruction (BSF) only works on 32 bits at a time. */
+static struct list ready_queues[PRI_CNT];
+static uint32_t ready_mask[2];
+static size_t ready_cnt;        /* # of threads in the run queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -38,6 +51,13 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Serializes thread_print_sched_stats(), whose buffers are too
+   big for a kernel stack. */
+static struct lock sched_stats_lock;
+
+#ifdef USERPROG
+#endif
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -51,6 +71,28 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Scheduler trace: a ring buffer of the most recent
+   SCHED_TRACE_SIZE context switches, for offline latency
+   analysis.  See thread_print_sched_stats() for the output
+   format. */
+#define SCHED_TRACE_SIZE 256
+struct sched_event
+  {
+    int64_t ns;                 /* Time of the switch, in ns since boot. */
+    tid_t prev;                 /* Thread switched away from. */
+    tid_t next;                 /* Thread switched to. */
+    uint8_t prev_status;        /* PREV's status after the switch. */
+    bool preempted;             /* Was PREV preempted? */
+  };
+static struct sched_event sched_trace[SCHED_TRACE_SIZE];
+static unsigned sched_trace_cnt;        /* # of switches ever recorded. */
+static bool preempting;         /* Is the current yield a preemption? */
+
+/* If true, print per-thread CPU accounting as threads exit and
+   the scheduler trace at shutdown.  Controlled by kernel
+   command-line option "-schedstats". */
+bool thread_sched_stats;
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
@@ -60,15 +102,38 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* 4.4BSD scheduler. */
+#define PRI_RECALC_TICKS 4      /* # of ticks between priority updates. */
+static fixed_t load_avg;        /* System load average. */
+
+/* Threads whose recent_cpu has changed since priorities were
+   last recomputed.  Between the once-per-second decays only the
+   running thread's recent_cpu changes, so this list stays short
+   and the 4-tick priority update never has to visit every
+   thread. */
+static struct list cpu_dirty_list;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
+static void mlfqs_tick (struct thread *, int64_t tick);
+static int mlfqs_priority (const struct thread *);
+static void mlfqs_update_priority (struct thread *, void *aux);
+static void mlfqs_decay_recent_cpu (struct thread *, void *aux);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
+static void yield (bool preempted);
+static void set_status (struct thread *, enum thread_status);
+static void print_thread_stats (tid_t, const char *name,
+                                enum thread_status,
+                                const struct thread_acct *);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 
@@ -88,11 +153,19 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  lock_init (&sched_stats_lock);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
   list_init (&all_list);
+  list_init (&cpu_dirty_list);
+#ifdef USERPROG
+  process_init ();
+#endif
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -118,14 +191,18 @@ thread_start (void)
   sema_down (&idle_started);
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+/* Called at timer tick number TICK, by the timer interrupt
+   handler or, for ticks that passed during tickless idle, by
+   the idle thread with interrupts off.  The tick number is
+   passed in because several may be processed back to back, so
+   timer_ticks() already counts the ones not yet handled. */
 void
-thread_tick (void) 
+thread_tick (int64_t tick) 
 {
   struct thread *t = thread_current ();
 
   /* Update statistics. */
+  t->acct.run_ticks++;
   if (t == idle_thread)
     idle_ticks++;
 #ifdef USERPROG
@@ -135,8 +212,12 @@ thread_tick (void)
   else
     kernel_ticks++;
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (thread_mlfqs)
+    mlfqs_tick (t, tick);
+
+  /* Enforce preemption.  The idle thread is about to block
+     anyway and may not be in an interrupt context. */
+  if (t != idle_thread && ++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
@@ -146,6 +227,107 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  if (thread_sched_stats)
+    thread_print_sched_stats ();
+}
+
+/* Names of thread states, for the scheduler statistics. */
+static const char *status_names[] = {"running", "ready", "blocked", "dying"};
+
+/* Maximum number of threads listed by thread_print_sched_stats(). */
+#define SCHED_STATS_MAX 64
+
+/* A thread's accounting, as copied by thread_print_sched_stats(). */
+struct sched_stat
+  {
+    tid_t tid;                          /* Thread identifier. */
+    char name[16];                      /* Thread name. */
+    enum thread_status status;          /* Thread state. */
+    struct thread_acct acct;            /* Accounting counters. */
+  };
+
+/* Prints the CPU accounting of every live thread and the
+   contents of the scheduler trace ring, oldest first, one record
+   per line in the machine-readable form
+
+     schedstat tid=T name=N status=S run=R ready=Q blocked=B
+               vcsw=V ivcsw=I syscalls=C
+     schedtrace ns=NS prev=T state=S preempted=P next=T
+
+   (each schedstat record is a single line).  Times in schedstat
+   records are in timer ticks.  At most SCHED_STATS_MAX threads
+   are listed.  The records are copied into static buffers with
+   interrupts off and printed afterward.  Callers with interrupts
+   on, such as system calls from any process, take turns with
+   sched_stats_lock; with interrupts off, as after a panic, no
+   other thread can get in anyway. */
+void
+thread_print_sched_stats (void)
+{
+  static struct sched_event trace[SCHED_TRACE_SIZE];
+  static struct sched_stat stats[SCHED_STATS_MAX];
+  unsigned cnt, first, i;
+  enum intr_level old_level;
+  struct list_elem *e;
+  bool locked = intr_get_level () == INTR_ON && !intr_context ();
+
+  if (locked)
+    lock_acquire (&sched_stats_lock);
+
+  old_level = intr_disable ();
+  cnt = sched_trace_cnt;
+  memcpy (trace, sched_trace, sizeof trace);
+  intr_set_level (old_level);
+
+  first = cnt > SCHED_TRACE_SIZE ? cnt - SCHED_TRACE_SIZE : 0;
+  for (i = first; i < cnt; i++)
+    {
+      const struct sched_event *ev = &trace[i % SCHED_TRACE_SIZE];
+      printf ("schedtrace ns=%lld prev=%d state=%s preempted=%d next=%d\n",
+              ev->ns, ev->prev, status_names[ev->prev_status],
+              ev->preempted, ev->next);
+    }
+
+  /* Threads can come and go while we print, so snapshot them
+     all first. */
+  old_level = intr_disable ();
+  cnt = 0;
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      if (cnt < SCHED_STATS_MAX)
+        {
+          stats[cnt].tid = t->tid;
+          memcpy (stats[cnt].name, t->name, sizeof stats[cnt].name);
+          stats[cnt].status = t->status;
+          stats[cnt].acct = t->acct;
+        }
+      cnt++;
+    }
+  intr_set_level (old_level);
+
+  for (i = 0; i < cnt && i < SCHED_STATS_MAX; i++)
+    print_thread_stats (stats[i].tid, stats[i].name, stats[i].status,
+                        &stats[i].acct);
+  if (cnt > SCHED_STATS_MAX)
+    printf ("schedstat omitted=%u\n", cnt - SCHED_STATS_MAX);
+
+  if (locked)
+    lock_release (&sched_stats_lock);
+}
+
+/* Prints the CPU accounting ACCT of the thread with the given
+   TID, NAME, and STATUS as a schedstat record. */
+static void
+print_thread_stats (tid_t tid, const char *name, enum thread_status status,
+                    const struct thread_acct *acct)
+{
+  printf ("schedstat tid=%d name=%s status=%s run=%lld ready=%lld "
+          "blocked=%lld vcsw=%u ivcsw=%u syscalls=%u\n",
+          tid, name, status_names[status], acct->run_ticks,
+          acct->ready_ticks, acct->blocked_ticks, acct->voluntary_switches,
+          acct->involuntary_switches, acct->syscall_cnt);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -160,9 +342,11 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   The new thread runs at priority PRIORITY, or, under the 4.4BSD
+   scheduler, at the priority computed from the nice value and
+   recent_cpu it inherits from its creator.  If that is higher
+   than the running thread's, the new thread preempts it before
+   thread_create() returns. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
@@ -172,6 +356,7 @@ thread_create (const char *name, int priority,
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
   tid_t tid;
+  bool preempt;
 
   ASSERT (function != NULL);
 
@@ -183,6 +368,7 @@ thread_create (const char *name, int priority,
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  preempt = t->priority > thread_get_priority ();
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -202,6 +388,10 @@ thread_create (const char *name, int priority,
   /* Add to run queue. */
   thread_unblock (t);
 
+  /* Run the new thread immediately if it outranks us. */
+  if (preempt)
+    thread_preempt ();
+
   return tid;
 }
 
@@ -214,10 +404,13 @@ thread_create (const char *name, int priority,
 void
 thread_block (void) 
 {
+  struct thread *cur = thread_current ();
+
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
-  thread_current ()->status = THREAD_BLOCKED;
+  set_status (cur, THREAD_BLOCKED);
+  cur->acct.voluntary_switches++;
   schedule ();
 }
 
@@ -238,8 +431,8 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
-  t->status = THREAD_READY;
+  ready_queue_push (t);
+  set_status (t, THREAD_READY);
   intr_set_level (old_level);
 }
 
@@ -281,18 +474,25 @@ thread_tid (void)
 void
 thread_exit (void) 
 {
+  struct thread *cur = thread_current ();
+
   ASSERT (!intr_context ());
 
 #ifdef USERPROG
   process_exit ();
 #endif
 
+  if (thread_sched_stats)
+    print_thread_stats (cur->tid, cur->name, cur->status, &cur->acct);
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
-  list_remove (&thread_current()->allelem);
-  thread_current ()->status = THREAD_DYING;
+  list_remove (&cur->allelem);
+  if (cur->cpu_dirty)
+    list_remove (&cur->dirtyelem);
+  set_status (cur, THREAD_DYING);
   schedule ();
   NOT_REACHED ();
 }
@@ -301,6 +501,24 @@ thread_exit (void)
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) 
+{
+  yield (false);
+}
+
+/* Like thread_yield(), but for when the scheduler takes the CPU
+   away from the current thread, e.g. at the end of its time
+   slice or because a higher-priority thread became ready.  The
+   difference only matters for CPU accounting. */
+void
+thread_preempt (void) 
+{
+  yield (true);
+}
+
+/* Yields the CPU, counting it as an involuntary context switch
+   if PREEMPTED is true or a voluntary one otherwise. */
+static void
+yield (bool preempted) 
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
@@ -309,12 +527,34 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
-  cur->status = THREAD_READY;
+    ready_queue_push (cur);
+  set_status (cur, THREAD_READY);
+  if (preempted)
+    cur->acct.involuntary_switches++;
+  else
+    cur->acct.voluntary_switches++;
+  preempting = preempted;
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Changes T's status to STATUS, charging the time since T's
+   last status change to its ready or blocked time as
+   appropriate.  Running time is charged separately, a tick at a
+   time, by thread_tick(). */
+static void
+set_status (struct thread *t, enum thread_status status)
+{
+  int64_t now = timer_ticks ();
+
+  if (t->status == THREAD_READY)
+    t->acct.ready_ticks += now - t->status_tick;
+  else if (t->status == THREAD_BLOCKED)
+    t->acct.blocked_ticks += now - t->status_tick;
+  t->status = status;
+  t->status_tick = now;
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -332,25 +572,28 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* 若该线程处于blocked状态，则减少其等待时间1tick，需要在中断关闭时调用 */
-void
-thread_decrease_ticks (struct thread *t, void *aux)
-{
-  if (t->wait_ticks > 0)
-  {
-    t->wait_ticks--;
-    if (t->wait_ticks == 0)
-    {
-      thread_unblock(t);
-    }
-  }
-}
-
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's priority to NEW_PRIORITY.  Yields
+   the CPU if some ready thread now has a higher priority.
+   Ignored under the 4.4BSD scheduler, which sets priorities
+   itself. */
 void
 thread_set_priority (int new_priority) 
 {
+  enum intr_level old_level;
+  bool preempt;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
   thread_current ()->priority = new_priority;
+  preempt = ready_queue_max_priority () > new_priority;
+  intr_set_level (old_level);
+
+  if (preempt)
+    thread_preempt ();
 }
 
 /* Returns the current thread's priority. */
@@ -360,35 +603,167 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority.  Yields the CPU if the running thread no longer
+   has the highest priority. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool preempt;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (cur, NULL);
+  preempt = ready_queue_max_priority () > cur->priority;
+  intr_set_level (old_level);
+
+  if (preempt)
+    thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent_cpu_100;
+}
+
+/* Changes the priority of thread T to PRIORITY, moving T to the
+   matching run queue if it is ready.  Must be called with
+   interrupts off. */
+static void
+change_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->priority == priority)
+    return;
+  if (t->status == THREAD_READY)
+    {
+      ready_queue_remove (t);
+      t->priority = priority;
+      ready_queue_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Returns T's 4.4BSD priority, computed from its recent_cpu and
+   nice values as
+
+        priority = PRI_MAX - (recent_cpu / 4) - (nice * 2)
+
+   and clamped to the range PRI_MIN...PRI_MAX. */
+static int
+mlfqs_priority (const struct thread *t)
+{
+  int priority = PRI_MAX - fp_to_int (t->recent_cpu / 4) - t->nice * 2;
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  return priority;
+}
+
+/* Recomputes T's 4.4BSD priority.  Must be called with
+   interrupts off. */
+static void
+mlfqs_update_priority (struct thread *t, void *aux UNUSED)
+{
+  if (t != idle_thread)
+    change_priority (t, mlfqs_priority (t));
+}
+
+/* Decays T's recent_cpu by the once-per-second factor
+
+        recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice
+
+   where the coefficient is passed in as *COEF_, and recomputes
+   T's priority.  Must be called with interrupts off. */
+static void
+mlfqs_decay_recent_cpu (struct thread *t, void *coef_)
+{
+  fixed_t *coef = coef_;
+
+  if (t == idle_thread)
+    return;
+
+  t->recent_cpu = fp_add_int (fp_mul (*coef, t->recent_cpu), t->nice);
+  mlfqs_update_priority (t, NULL);
+}
+
+/* Does the 4.4BSD scheduler's per-tick work for CUR, the running
+   thread.  Called from thread_tick() in the timer interrupt.
+
+   Each tick only CUR's recent_cpu is charged.  Every
+   PRI_RECALC_TICKS ticks, priorities are recomputed for just the
+   threads charged since the last recomputation.  Only once per
+   second, when load_avg and every thread's recent_cpu decay, do
+   we visit all threads. */
+static void
+mlfqs_tick (struct thread *cur, int64_t ticks)
+{
+  if (cur != idle_thread)
+    {
+      cur->recent_cpu = fp_add_int (cur->recent_cpu, 1);
+      if (!cur->cpu_dirty)
+        {
+          cur->cpu_dirty = true;
+          list_push_back (&cpu_dirty_list, &cur->dirtyelem);
+        }
+    }
+
+  if (ticks % TIMER_FREQ == 0)
+    {
+      /* load_avg = (59/60)*load_avg + (1/60)*ready_threads. */
+      int ready_threads = ready_cnt + (cur != idle_thread ? 1 : 0);
+      fixed_t coef;
+
+      load_avg = load_avg * 59 / 60 + fp_from_int (ready_threads) / 60;
+      coef = fp_div (2 * load_avg, fp_add_int (2 * load_avg, 1));
+      thread_foreach (mlfqs_decay_recent_cpu, &coef);
+      while (!list_empty (&cpu_dirty_list))
+        list_entry (list_pop_front (&cpu_dirty_list),
+                    struct thread, dirtyelem)->cpu_dirty = false;
+    }
+  else if (ticks % PRI_RECALC_TICKS == 0)
+    {
+      while (!list_empty (&cpu_dirty_list))
+        {
+          struct thread *t = list_entry (list_pop_front (&cpu_dirty_list),
+                                         struct thread, dirtyelem);
+          t->cpu_dirty = false;
+          mlfqs_update_priority (t, NULL);
+        }
+    }
+
+  if (cur != idle_thread && ready_queue_max_priority () > cur->priority)
+    intr_yield_on_return ();
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -409,10 +784,17 @@ idle (void *idle_started_ UNUSED)
 
   for (;;) 
     {
-      /* Let someone else run. */
+      /* Let someone else run.  If an interrupt woke somebody
+         while we were halted, the PIT may still be set for a
+         distant timer event; put the periodic tick back first. */
       intr_disable ();
+      timer_resume ();
       thread_block ();
 
+      /* Nothing is runnable, so there is no need for periodic
+         ticks until the next timer event. */
+      timer_idle ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -474,27 +856,42 @@ init_thread (struct thread *t, const char *name, int priority)
 
   memset (t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
+  t->status_tick = timer_ticks ();
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
   t->magic = THREAD_MAGIC;
 
+  /* New threads inherit the 4.4BSD scheduler state of their
+     creator, and under that scheduler the PRIORITY argument is
+     ignored. */
+  if (t != initial_thread)
+    {
+      t->nice = running_thread ()->nice;
+      t->recent_cpu = running_thread ()->recent_cpu;
+    }
+  if (thread_mlfqs)
+    t->priority = mlfqs_priority (t);
+
 #ifdef USERPROG
-  sema_init(&t->some_semaphore, 0);
   sema_init(&t->wait_exec, 0);
-  t->cur_waitpid = 0;
   if (t != initial_thread)
-  {
     t->parent = running_thread ();
-    struct cthread *ct = (struct cthread *) palloc_get_page (0);
-    ct->cthread = t;
-    ct->exit_status = 16;
-    list_push_back (&t->parent->ct_list, &ct->ctelem);
-  }
+  t->cstatus = NULL;
+  t->exit_status = -1;
+  cond_init (&t->child_exited);
   t->fd = 1;
   t->child_status = 0;
   list_init (&t->file_list);
   list_init (&t->ct_list);
+  list_init (&t->shm_maps);
+  t->leader = t;
+  lock_init (&t->proc_lock);
+  list_init (&t->uthreads);
+  t->thread_cnt = 1;
+  sema_init (&t->threads_gone, 0);
+  wait_queue_init (&t->exit_waits);
+  t->stack_slots = 1;
 #endif
 
   old_level = intr_disable ();
@@ -515,18 +912,88 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Returns the index into ready_queues[] and ready_mask[] for
+   threads of priority PRIORITY. */
+static inline int
+ready_queue_idx (int priority)
+{
+  return PRI_MAX - priority;
+}
+
+/* Appends T to the back of the run queue for its priority.
+   Must be called with interrupts off. */
+static void
+ready_queue_push (struct thread *t)
+{
+  int idx = ready_queue_idx (t->priority);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&ready_queues[idx], &t->elem);
+  ready_mask[idx / 32] |= 1u << (idx % 32);
+  ready_cnt++;
+}
+
+/* Removes ready thread T from its run queue.  Must be called
+   with interrupts off. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  int idx = ready_queue_idx (t->priority);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[idx]))
+    ready_mask[idx / 32] &= ~(1u << (idx % 32));
+  ready_cnt--;
+}
+
+/* Returns the index of the highest-priority nonempty run queue,
+   or -1 if all of them are empty. */
+static int
+ready_queue_first (void)
+{
+  if (ready_mask[0] != 0)
+    return __builtin_ctz (ready_mask[0]);
+  else if (ready_mask[1] != 0)
+    return 32 + __builtin_ctz (ready_mask[1]);
+  else
+    return -1;
+}
+
+/* Returns the priority of the highest-priority ready thread, or
+   PRI_MIN - 1 if no thread is ready.  Must be called with
+   interrupts off. */
+static int
+ready_queue_max_priority (void)
+{
+  int idx = ready_queue_first ();
+  return idx >= 0 ? PRI_MAX - idx : PRI_MIN - 1;
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   idle_thread.
+
+   The highest-priority nonempty queue is found in constant
+   time by a find-first-set on ready_mask, and threads of equal
+   priority are scheduled round-robin. */
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  int idx = ready_queue_first ();
+  struct thread *t;
+
+  if (idx < 0)
     return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+  t = list_entry (list_front (&ready_queues[idx]), struct thread, elem);
+  ready_queue_remove (t);
+  return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -553,7 +1020,7 @@ thread_schedule_tail (struct thread *prev)
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Mark us as running. */
-  cur->status = THREAD_RUNNING;
+  set_status (cur, THREAD_RUNNING);
 
   /* Start new time slice. */
   thread_ticks = 0;
@@ -588,13 +1055,26 @@ schedule (void)
   struct thread *cur = running_thread ();
   struct thread *next = next_thread_to_run ();
   struct thread *prev = NULL;
+  bool preempted = preempting;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  preempting = false;
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      /* Record the switch in the scheduler trace. */
+      struct sched_event *ev = &sched_trace[sched_trace_cnt++
+                                            % SCHED_TRACE_SIZE];
+      ev->ns = timer_ns ();
+      ev->prev = cur->tid;
+      ev->next = next->tid;
+      ev->prev_status = cur->status;
+      ev->preempted = preempted;
+
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
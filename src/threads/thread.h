@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/synch.h"
 
 /* States in a thread's life cycle. */
@@ -25,6 +26,22 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the 4.4BSD scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
+/* Per-thread CPU accounting. */
+struct thread_acct
+  {
+    int64_t run_ticks;                  /* Ticks spent running. */
+    int64_t ready_ticks;                /* Ticks spent in a run queue. */
+    int64_t blocked_ticks;              /* Ticks spent blocked. */
+    unsigned voluntary_switches;        /* # of times blocked or yielded. */
+    unsigned involuntary_switches;      /* # of times preempted. */
+    unsigned syscall_cnt;               /* # of system calls made. */
+  };
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -89,35 +106,67 @@ struct thread
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
-    int64_t wait_ticks;
     struct list_elem allelem;           /* List element for all threads list. */
 
+    /* 4.4BSD scheduler state, owned by thread.c. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* Recent CPU time received. */
+    bool cpu_dirty;                     /* On cpu_dirty_list? */
+    struct list_elem dirtyelem;         /* Element in cpu_dirty_list. */
+
+    /* CPU accounting, owned by thread.c. */
+    struct thread_acct acct;            /* Accounting counters. */
+    int64_t status_tick;                /* Tick of last status change. */
+
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 #define USERPROG
 #ifdef USERPROG
-    /* Owned by userprog/process.c. */
+    /* Owned by userprog/process.c.  A process's threads share
+       the state kept in its first thread, the leader; the fields
+       from leader on are meaningful only there. */
     uint32_t *pagedir;                  /* Page directory. */
-    struct semaphore some_semaphore;    /* 用于实现简单的process_wait */
+    struct thread *leader;              /* Our process's first thread. */
+    struct uthread *uthread;            /* Our record, if not the leader. */
     struct semaphore wait_exec;         /* 用于等待子进程执行完毕exec */
-    tid_t cur_waitpid;                  /* 当前线程正在等待的线程id */
     struct thread *parent;              /* The parent thread. */
+    struct cthread *cstatus;            /* Our record in parent's ct_list. */
+    int exit_status;                    /* Status to report to parent. */
+    struct condition child_exited;      /* Signaled when a child exits. */
     int fd;                             /* 该线程的文件描述符 */
     struct list file_list;              /* 当前线程打开文件的列表 */
     int child_status;                   /* exec()子进程的运行状态 */
     struct list ct_list;                /* 当前线程的子线程列表 */
+    struct list shm_maps;               /* Shared memory mappings. */
+    struct lock proc_lock;              /* Guards fds, maps, pagedir. */
+    struct list uthreads;               /* Records of other threads. */
+    int thread_cnt;                     /* Live threads, including us. */
+    bool exiting;                       /* Are our threads to die? */
+    struct wait_queue exit_waits;       /* Sleepers to wake on exit. */
+    struct semaphore threads_gone;      /* Upped when thread_cnt hits 1. */
+    uint32_t stack_slots;               /* User stack slots in use. */
+#endif
+#ifdef FILESYS
+    /* Owned by filesys/journal.c. */
+    int journal_depth;                  /* Nesting of journal_begin(). */
 #endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
 
-/* 记录子进程的信息 */
+/* 记录子进程的信息.
+   Shared by a child and its parent, so that the exit status
+   survives the child's struct thread.  Freed when both are done
+   with it.  Owned by userprog/process.c. */
 #ifdef USERPROG
    struct cthread 
    {
-      struct thread *cthread;            /* 子进程tid */
-      int exit_status;                   /* 退出状态, 等于100表示正在运行 */
+      tid_t tid;                         /* 子进程tid */
+      int exit_status;                   /* 退出状态, valid once EXITED */
+      bool exited;                       /* Has the child exited? */
+      int ref_cnt;                       /* Parent and/or child still using. */
+      struct thread *parent;             /* Parent, or NULL once it exits. */
       struct list_elem ctelem;           /* 当前线程的子线程列表元素 */
    };
 #endif
@@ -129,11 +178,17 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, print per-thread CPU accounting as threads exit and
+   the scheduler trace at shutdown.  Controlled by kernel
+   command-line option "-schedstats". */
+extern bool thread_sched_stats;
+
 void thread_init (void);
 void thread_start (void);
 
-void thread_tick (void);
+void thread_tick (int64_t tick);
 void thread_print_stats (void);
+void thread_print_sched_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -147,14 +202,12 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
-/* 若该线程处于blocked状态，则减少其等待时间 1 tick，需要在中断关闭时调用 */
-void thread_decrease_ticks (struct thread *t, void *aux);
-
 int thread_get_priority (void);
 void thread_set_priority (int);
 
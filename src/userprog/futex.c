@@ -0,0 +1,171 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+/* Futexes ("fast user-space mutexes").
+
+   A futex is just an int in user memory.  User code updates it
+   with atomic instructions and calls into the kernel only to
+   sleep, when it finds the value says it must wait, or to wake
+   sleepers, when the value says there may be some.  A lock that
+   is never contended thus never enters the kernel.
+
+   futex_wait() puts the caller to sleep only if the int still
+   holds the value the caller expects, checking and queuing under
+   the same lock that futex_wake() takes, so that a wakeup between
+   the caller's last look at the value and its sleep is not lost.
+
+   Sleepers are queued by the kernel address of the int, that is,
+   by physical address, found through the process's page
+   directory.  Two processes that share the int through a shared
+   memory segment therefore meet in the same queue even if they
+   map it at different user addresses. */
+
+/* Number of hash buckets.  Each has its own lock. */
+#define FUTEX_BUCKETS 64
+
+struct futex_bucket
+  {
+    struct lock lock;           /* Protects waiters. */
+    struct list waiters;        /* List of struct futex_waiter. */
+  };
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter
+  {
+    const int *key;             /* Kernel address of the futex. */
+    struct thread *leader;      /* Leader of the sleeper's process. */
+    struct semaphore wakeup;    /* Upped to wake the sleeper. */
+    struct list_elem elem;      /* Element in bucket's waiters. */
+  };
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void) 
+{
+  size_t i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++) 
+    {
+      lock_init (&buckets[i].lock);
+      list_init (&buckets[i].waiters);
+    }
+}
+
+/* Returns the kernel address at which the running process's
+   user address UADDR can be reached, or a null pointer if UADDR
+   is unmapped. */
+static const int *
+futex_key (const int *uaddr) 
+{
+  return pagedir_get_page (thread_current ()->pagedir, uaddr);
+}
+
+/* Returns the bucket for the futex at kernel address KEY. */
+static struct futex_bucket *
+futex_bucket (const int *key) 
+{
+  return &buckets[hash_int ((int) key) % FUTEX_BUCKETS];
+}
+
+/* If the int at UADDR, which must be aligned, holds EXPECTED,
+   sleeps until futex_wake() is called for it.  Returns true if it
+   slept, false if the value differed, UADDR is unmapped, or the
+   running process is exiting. */
+bool
+futex_wait (const int *uaddr, int expected) 
+{
+  const int *key = futex_key (uaddr);
+  struct futex_bucket *b;
+  struct futex_waiter w;
+
+  if (key == NULL)
+    return false;
+
+  b = futex_bucket (key);
+  lock_acquire (&b->lock);
+  if (*key != expected || process_current ()->exiting) 
+    {
+      lock_release (&b->lock);
+      return false;
+    }
+  w.key = key;
+  w.leader = process_current ();
+  sema_init (&w.wakeup, 0);
+  list_push_back (&b->waiters, &w.elem);
+  lock_release (&b->lock);
+
+  sema_down (&w.wakeup);
+  return true;
+}
+
+/* Wakes up to CNT threads sleeping on the int at UADDR, which
+   must be aligned, in the order they went to sleep.  Returns the
+   number woken. */
+int
+futex_wake (const int *uaddr, int cnt) 
+{
+  const int *key = futex_key (uaddr);
+  struct futex_bucket *b;
+  struct list_elem *e;
+  int woken = 0;
+
+  if (key == NULL)
+    return 0;
+
+  b = futex_bucket (key);
+  lock_acquire (&b->lock);
+  for (e = list_begin (&b->waiters);
+       e != list_end (&b->waiters) && woken < cnt; )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+      if (w->key == key) 
+        {
+          e = list_remove (e);
+          sema_up (&w->wakeup);
+          woken++;
+        }
+      else
+        e = list_next (e);
+    }
+  lock_release (&b->lock);
+  return woken;
+}
+
+/* Wakes every thread of the process led by LEADER that sleeps on
+   any futex.  LEADER's process must already be marked exiting,
+   so that none of its threads goes back to sleep. */
+void
+futex_wake_process (struct thread *leader) 
+{
+  size_t i;
+
+  ASSERT (leader->exiting);
+
+  for (i = 0; i < FUTEX_BUCKETS; i++) 
+    {
+      struct futex_bucket *b = &buckets[i];
+      struct list_elem *e;
+
+      lock_acquire (&b->lock);
+      for (e = list_begin (&b->waiters); e != list_end (&b->waiters); )
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+          if (w->leader == leader) 
+            {
+              e = list_remove (e);
+              sema_up (&w->wakeup);
+            }
+          else
+            e = list_next (e);
+        }
+      lock_release (&b->lock);
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdbool.h>
+
+struct thread;
+
+void futex_init (void);
+bool futex_wait (const int *uaddr, int expected);
+int futex_wake (const int *uaddr, int cnt);
+void futex_wake_process (struct thread *leader);
+
+#endif /* userprog/futex.h */
@@ -3,36 +3,82 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
 
+/* Page directories released by exiting processes, waiting for
+   the reaper thread to destroy them.  A released page directory
+   is never loaded into CR3 again, so its kernel half is no
+   longer needed; its first kernel PDE links it to the next one
+   in the queue.  Accessed only with interrupts off. */
+static uint32_t *reap_head, *reap_tail;
+#define REAP_NEXT(PD) ((PD)[pd_no (PHYS_BASE)])
+
+/* Upped once for each page directory added to the queue. */
+static struct semaphore reap_sema;
+
+/* Held while a page directory is being destroyed, so that
+   pagedir_reap() can wait for the reaper's work in progress. */
+static struct lock reap_lock;
+
+static thread_func reaper NO_RETURN;
+static uint32_t *reap_pop (void);
+
+/* Starts the reaper thread and makes the page allocator fall
+   back to it when memory runs short. */
+void
+pagedir_init (void) 
+{
+  sema_init (&reap_sema, 0);
+  lock_init (&reap_lock);
+  thread_create ("reaper", PRI_DEFAULT, reaper, NULL);
+  palloc_set_reclaim (pagedir_reap);
+}
+
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
-   allocation fails. */
+   allocation fails.
+
+   The kernel page tables are shared by every page directory:
+   only the kernel PDEs that point to them are copied from
+   init_page_dir.  This is safe because paging_init() creates all
+   the kernel page tables there will ever be. */
 uint32_t *
 pagedir_create (void) 
 {
   uint32_t *pd = palloc_get_page (0);
-  if (pd != NULL)
-    memcpy (pd, init_page_dir, PGSIZE);
+  if (pd != NULL) 
+    {
+      size_t kernel_pde = pd_no (PHYS_BASE);
+
+      memset (pd, 0, kernel_pde * sizeof *pd);
+      memcpy (pd + kernel_pde, init_page_dir + kernel_pde,
+              PGSIZE - kernel_pde * sizeof *pd);
+    }
   return pd;
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  The pages go back to the allocator in batches. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
+  void *batch[64];
+  size_t batch_cnt = 0;
   uint32_t *pde;
 
   if (pd == NULL)
     return;
 
   ASSERT (pd != init_page_dir);
+  ASSERT (pd != active_pd ());
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
     if (*pde & PTE_P) 
       {
@@ -41,12 +87,97 @@ pagedir_destroy (uint32_t *pd)
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
           if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
+            {
+              batch[batch_cnt++] = pte_get_page (*pte);
+              if (batch_cnt == sizeof batch / sizeof *batch) 
+                {
+                  palloc_free_pages (batch, batch_cnt);
+                  batch_cnt = 0;
+                }
+            }
+        palloc_free_pages (batch, batch_cnt);
+        batch_cnt = 0;
         palloc_free_page (pt);
       }
   palloc_free_page (pd);
 }
 
+/* Hands page directory PD to the reaper thread, which destroys
+   it later, so that an exiting process doesn't have to wait for
+   its pages to be freed.  PD must not be active. */
+void
+pagedir_release (uint32_t *pd) 
+{
+  enum intr_level old_level;
+
+  if (pd == NULL)
+    return;
+
+  ASSERT (pd != init_page_dir);
+  ASSERT (pd != active_pd ());
+
+  REAP_NEXT (pd) = 0;
+  old_level = intr_disable ();
+  if (reap_tail != NULL)
+    REAP_NEXT (reap_tail) = (uintptr_t) pd;
+  else
+    reap_head = pd;
+  reap_tail = pd;
+  sema_up (&reap_sema);
+  intr_set_level (old_level);
+}
+
+/* Destroys every page directory waiting for the reaper, and
+   waits for the one it is working on, if any.  Called by the
+   page allocator when it runs short of pages. */
+void
+pagedir_reap (void) 
+{
+  uint32_t *pd;
+
+  lock_acquire (&reap_lock);
+  while ((pd = reap_pop ()) != NULL)
+    pagedir_destroy (pd);
+  lock_release (&reap_lock);
+}
+
+/* Removes and returns the page directory at the head of the
+   reaper's queue, or a null pointer if it is empty. */
+static uint32_t *
+reap_pop (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t *pd = reap_head;
+
+  if (pd != NULL) 
+    {
+      reap_head = (uint32_t *) REAP_NEXT (pd);
+      if (reap_head == NULL)
+        reap_tail = NULL;
+    }
+  intr_set_level (old_level);
+  return pd;
+}
+
+/* The reaper thread.  Destroys released page directories as they
+   arrive.  pagedir_reap() may have taken a directory first, so
+   the semaphore count is only a hint. */
+static void
+reaper (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      uint32_t *pd;
+
+      sema_down (&reap_sema);
+      lock_acquire (&reap_lock);
+      pd = reap_pop ();
+      if (pd != NULL)
+        pagedir_destroy (pd);
+      lock_release (&reap_lock);
+    }
+}
+
 /* Returns the address of the page table entry for virtual
    address VADDR in page directory PD.
    If PD does not have a page table for VADDR, behavior depends
@@ -230,6 +361,22 @@ pagedir_activate (uint32_t *pd)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
 }
 
+/* Makes PD's user mappings available to the CPU, like
+   pagedir_activate(), but without reloading CR3, and so flushing
+   the user part of the TLB, when it can be avoided: when PD is
+   already active, or when PD is a null pointer, because a thread
+   without user mappings can run on any page directory's kernel
+   half.
+
+   Not suitable for leaving a page directory that is about to be
+   destroyed; use pagedir_activate (NULL) for that. */
+void
+pagedir_switch (uint32_t *pd) 
+{
+  if (pd != NULL && pd != active_pd ())
+    pagedir_activate (pd);
+}
+
 /* Returns the currently active page directory. */
 static uint32_t *
 active_pd (void) 
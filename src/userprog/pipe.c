@@ -0,0 +1,230 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Pipes between user processes.
+
+   A pipe is a ring buffer in kernel memory with a read end and a
+   write end.  Each end may be open in any number of file
+   descriptors, in any number of processes, because descriptors
+   are inherited across exec.  The pipe counts the open
+   descriptors on each side, so that readers see end of file once
+   the last writer has closed, and writers see an error once the
+   last reader has closed.  The pipe is freed when both counts
+   reach zero.
+
+   Besides its condition variables, a pipe has a wait queue for
+   poll(), woken on every change that could make a read or write
+   succeed without waiting. */
+
+/* Size of a pipe's ring buffer, in pages. */
+#define PIPE_PAGES 1
+#define PIPE_SIZE (PIPE_PAGES * PGSIZE)
+
+struct pipe
+  {
+    struct lock lock;           /* Protects all the members below. */
+    struct condition readable;  /* Data arrived or last writer left. */
+    struct condition writable;  /* Room freed or last reader left. */
+    struct wait_queue poll;     /* Woken on either of the above. */
+    uint8_t *buf;               /* Ring buffer, PIPE_SIZE bytes. */
+    size_t head;                /* Total bytes ever written. */
+    size_t tail;                /* Total bytes ever read. */
+    int readers;                /* Open descriptors for read end. */
+    int writers;                /* Open descriptors for write end. */
+  };
+
+/* Creates and returns a new pipe with one descriptor open on each
+   end, or a null pointer if memory is short. */
+struct pipe *
+pipe_create (void) 
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->buf = palloc_get_multiple (0, PIPE_PAGES);
+  if (p->buf == NULL) 
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->readable);
+  cond_init (&p->writable);
+  wait_queue_init (&p->poll);
+  p->head = p->tail = 0;
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Notes that another descriptor has been opened on P's write end,
+   if WRITER is true, or its read end otherwise. */
+void
+pipe_dup (struct pipe *p, bool writer) 
+{
+  lock_acquire (&p->lock);
+  if (writer)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Closes a descriptor on P's write end, if WRITER is true, or its
+   read end otherwise.  Frees P if that was the last descriptor
+   open on it. */
+void
+pipe_close (struct pipe *p, bool writer) 
+{
+  bool last;
+
+  lock_acquire (&p->lock);
+  if (writer) 
+    {
+      ASSERT (p->writers > 0);
+      if (--p->writers == 0)
+        cond_broadcast (&p->readable, &p->lock);
+    }
+  else 
+    {
+      ASSERT (p->readers > 0);
+      if (--p->readers == 0)
+        cond_broadcast (&p->writable, &p->lock);
+    }
+  wait_queue_wake (&p->poll);
+  last = p->readers == 0 && p->writers == 0;
+  lock_release (&p->lock);
+
+  if (last) 
+    {
+      palloc_free_multiple (p->buf, PIPE_PAGES);
+      free (p);
+    }
+}
+
+/* Reads up to SIZE bytes from P into BUFFER.  Waits until at
+   least one byte is available, then returns whatever is there,
+   up to SIZE bytes.  Returns 0 at end of file, that is, if P is
+   empty and its write end is closed everywhere.  If NONBLOCK is
+   true, returns -1 instead of waiting. */
+int
+pipe_read (struct pipe *p, void *buffer_, size_t size, bool nonblock) 
+{
+  uint8_t *buffer = buffer_;
+  size_t cnt, ofs, chunk;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&p->lock);
+  while (p->head == p->tail && p->writers > 0) 
+    {
+      if (nonblock) 
+        {
+          lock_release (&p->lock);
+          return -1;
+        }
+      cond_wait (&p->readable, &p->lock);
+    }
+
+  cnt = p->head - p->tail;
+  if (cnt > size)
+    cnt = size;
+
+  /* Copy in up to two pieces, for when the data wraps around the
+     end of the ring. */
+  ofs = p->tail % PIPE_SIZE;
+  chunk = cnt < PIPE_SIZE - ofs ? cnt : PIPE_SIZE - ofs;
+  memcpy (buffer, p->buf + ofs, chunk);
+  memcpy (buffer + chunk, p->buf, cnt - chunk);
+  p->tail += cnt;
+
+  if (cnt > 0) 
+    {
+      cond_broadcast (&p->writable, &p->lock);
+      wait_queue_wake (&p->poll);
+    }
+  lock_release (&p->lock);
+  return cnt;
+}
+
+/* Writes the SIZE bytes in BUFFER to P, waiting for room as
+   necessary.  Returns SIZE, or fewer if P's read end is closed
+   everywhere partway through, or -1 if it was closed before
+   anything could be written.  If NONBLOCK is true, writes only
+   what fits without waiting, returning -1 if nothing does. */
+int
+pipe_write (struct pipe *p, const void *buffer_, size_t size,
+            bool nonblock) 
+{
+  const uint8_t *buffer = buffer_;
+  size_t done = 0;
+
+  lock_acquire (&p->lock);
+  while (done < size && p->readers > 0) 
+    {
+      size_t room = PIPE_SIZE - (p->head - p->tail);
+      size_t ofs, chunk;
+
+      if (room == 0) 
+        {
+          if (nonblock)
+            break;
+          cond_wait (&p->writable, &p->lock);
+          continue;
+        }
+
+      ofs = p->head % PIPE_SIZE;
+      chunk = size - done;
+      if (chunk > room)
+        chunk = room;
+      if (chunk > PIPE_SIZE - ofs)
+        chunk = PIPE_SIZE - ofs;
+      memcpy (p->buf + ofs, buffer + done, chunk);
+      p->head += chunk;
+      done += chunk;
+      cond_broadcast (&p->readable, &p->lock);
+      wait_queue_wake (&p->poll);
+    }
+  lock_release (&p->lock);
+
+  return done > 0 || size == 0 ? (int) done : -1;
+}
+
+/* Returns the poll() events ready on P's write end, if WRITER is
+   true, or its read end otherwise.  If E is nonnull, also adds E
+   to P's wait queue, to up SEMA whenever that may change.  The
+   caller must keep a descriptor open on P until it removes E. */
+int
+pipe_poll (struct pipe *p, bool writer, struct wait_entry *e,
+           struct semaphore *sema) 
+{
+  int events = 0;
+
+  lock_acquire (&p->lock);
+  if (e != NULL)
+    wait_queue_add (&p->poll, e, sema);
+  if (writer) 
+    {
+      if (p->readers == 0)
+        events |= POLLERR;
+      else if (p->head - p->tail < PIPE_SIZE)
+        events |= POLLOUT;
+    }
+  else 
+    {
+      if (p->head != p->tail)
+        events |= POLLIN;
+      if (p->writers == 0)
+        events |= POLLHUP;
+    }
+  lock_release (&p->lock);
+  return events;
+}
@@ -0,0 +1,19 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct pipe;
+struct semaphore;
+struct wait_entry;
+
+struct pipe *pipe_create (void);
+void pipe_dup (struct pipe *, bool writer);
+void pipe_close (struct pipe *, bool writer);
+int pipe_read (struct pipe *, void *, size_t, bool nonblock);
+int pipe_write (struct pipe *, const void *, size_t, bool nonblock);
+int pipe_poll (struct pipe *, bool writer, struct wait_entry *,
+               struct semaphore *);
+
+#endif /* userprog/pipe.h */
@@ -6,8 +6,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/shm.h"
 #include "userprog/tss.h"
 #include "userprog/syscall.h"
 #include "filesys/directory.h"
@@ -16,12 +18,98 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 
+/* Cache of struct cthread, the records of a process's children. */
+static struct kmem_cache *cthread_cache;
+
+/* Protects every struct cthread's reference count and parent
+   pointer, and every thread's ct_list. */
+static struct lock ct_lock;
+
+/* A process may have up to UTHREAD_MAX threads.  Thread N runs
+   on a one-page user stack at the top of the Nth slot of
+   UTHREAD_STACK_SPACING bytes below PHYS_BASE; the first thread
+   uses slot 0, the stack that load() sets up. */
+#define UTHREAD_MAX 32
+#define UTHREAD_STACK_SPACING (1024 * 1024)
+
+/* A process's thread other than its leader: the record through
+   which thread_join() learns that it has exited.  Kept in the
+   leader's uthreads list until joined, or until the process
+   exits. */
+struct uthread
+  {
+    tid_t tid;                          /* The thread's tid. */
+    int slot;                           /* Its user stack slot. */
+    struct semaphore done;              /* Upped when it exits. */
+    struct list_elem elem;              /* Element in uthreads. */
+  };
+
+/* Protects the uthreads, thread_cnt, exiting and stack_slots
+   members of every process's leader. */
+static struct lock ut_lock;
+
+/* What process_execute() hands to start_process(). */
+struct exec_info
+  {
+    char *cmd_line;                     /* Command line, in a page. */
+    struct cthread *cstatus;            /* Record for our exit status. */
+  };
+
+/* What process_thread_create() hands to start_thread(). */
+struct thread_info
+  {
+    struct thread *leader;              /* The process to join. */
+    struct uthread *uthread;            /* The new thread's record. */
+    void (*eip) (void);                 /* User entry point. */
+    void *esp;                          /* Initial user stack pointer. */
+    struct semaphore started;           /* Upped once copied. */
+  };
+
 static thread_func start_process NO_RETURN;
+static thread_func start_thread NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static void put_cthread (struct cthread *);
+static void exit_thread (void);
+static void *stack_page (int slot);
+
+/* Initializes the child status records and the futexes. */
+void
+process_init (void) 
+{
+  lock_init (&ct_lock);
+  lock_init (&ut_lock);
+  futex_init ();
+  cthread_cache = kmem_cache_create ("cthread", sizeof (struct cthread),
+                                     NULL);
+}
+
+/* Returns the leader of the running thread's process, which holds
+   the state that all of the process's threads share.  A kernel
+   thread is its own leader. */
+struct thread *
+process_current (void) 
+{
+  return thread_current ()->leader;
+}
+
+/* Drops a reference to CT, freeing it if that was the last.
+   The caller must hold ct_lock. */
+static void
+put_cthread (struct cthread *ct) 
+{
+  ASSERT (lock_held_by_current_thread (&ct_lock));
+  ASSERT (ct->ref_cnt > 0);
+
+  if (--ct->ref_cnt == 0)
+    kmem_cache_free (cthread_cache, ct);
+}
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -34,6 +122,8 @@ process_execute (const char *file_name)
   if (file_name == NULL)
     return TID_ERROR;
   
+  struct thread *cur = thread_current ();
+  struct exec_info info;
   char *fn_copy;
   tid_t tid;
 
@@ -73,11 +163,45 @@ process_execute (const char *file_name)
 
     */
 
+  /* Make the record through which the child will report its
+     exit status.  It belongs to our process, not just to us, so
+     that any of our threads can wait for the child. */
+  info.cmd_line = fn_copy;
+  info.cstatus = kmem_cache_alloc (cthread_cache);
+  if (info.cstatus == NULL) 
+    {
+      palloc_free_page (fn_copy);
+      return TID_ERROR;
+    }
+  info.cstatus->exit_status = -1;
+  info.cstatus->exited = false;
+  info.cstatus->ref_cnt = 2;
+  info.cstatus->parent = cur->leader;
+
   /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (exec_name, PRI_DEFAULT, start_process, fn_copy);
-  sema_down(&thread_current()->wait_exec);
-  if (thread_current ()->child_status == -1)
+  cur->child_status = 0;
+  tid = thread_create (exec_name, PRI_DEFAULT, start_process, &info);
+  if (tid != TID_ERROR)
+    sema_down (&cur->wait_exec);
+  if (cur->child_status == -1)
     tid = TID_ERROR;
+
+  lock_acquire (&ct_lock);
+  if (tid != TID_ERROR) 
+    {
+      info.cstatus->tid = tid;
+      list_push_back (&cur->leader->ct_list, &info.cstatus->ctelem);
+      if (info.cstatus->exited)
+        cond_broadcast (&cur->leader->child_exited, &ct_lock);
+    }
+  else
+    {
+      /* Drop the child's reference too if it never got to run. */
+      if (cur->child_status != -1)
+        put_cthread (info.cstatus);
+      put_cthread (info.cstatus);
+    }
+  lock_release (&ct_lock);
   if (tid == TID_ERROR)
     palloc_free_page (fn_copy);
   return tid;
@@ -86,13 +210,21 @@ process_execute (const char *file_name)
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *_file_name)
+start_process (void *info_)
 {
-  char *file_name = (char*)_file_name;
+  struct exec_info *info = info_;
+  char *file_name = info->cmd_line;
   struct intr_frame if_;
   bool success;
   // printf ("start process...\n");
 
+  thread_current ()->cstatus = info->cstatus;
+
+  /* Take copies of our parent's descriptors.  Our parent is
+     waiting in process_execute() and holds its process's
+     proc_lock, so they can't change under us. */
+  syscall_inherit_fds (thread_current ()->parent);
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
@@ -187,33 +319,143 @@ start_process (void *_file_name)
    been successfully called for the given TID, returns -1
    immediately, without waiting.
 
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   Each child has its own semaphore, so any number of children
+   can be waited for, one after another, without the wakeups
+   getting mixed up. */
 int
 process_wait (tid_t child_tid) 
 {
+  struct thread *cur = process_current ();
+  struct cthread *ct = NULL;
   struct list_elem *e;
-  for (e = list_begin (&thread_current()->ct_list); e != list_end (&thread_current()->ct_list);
-      e = list_next (e))
-    {
-      struct cthread *ct = list_entry (e, struct cthread, ctelem);
-      if (ct->cthread->tid == child_tid) 
+  int status;
+
+  /* Claim the record, so that a second wait for the same
+     child fails. */
+  lock_acquire (&ct_lock);
+  for (e = list_begin (&cur->ct_list); e != list_end (&cur->ct_list);
+       e = list_next (e))
+    if (list_entry (e, struct cthread, ctelem)->tid == child_tid) 
       {
-        thread_current ()->cur_waitpid = child_tid;
-        sema_down (&thread_current ()->some_semaphore);
-        return ct->exit_status;
+        ct = list_entry (e, struct cthread, ctelem);
+        list_remove (e);
+        break;
       }
+  if (ct == NULL) 
+    {
+      lock_release (&ct_lock);
+      return -1;
     }
-  return -1;
+
+  /* Give up if our own process starts to exit meanwhile.  The
+     child then has nobody to tell. */
+  while (!ct->exited && !cur->exiting)
+    cond_wait (&cur->child_exited, &ct_lock);
+  status = ct->exited ? ct->exit_status : -1;
+  if (!ct->exited)
+    ct->parent = NULL;
+  put_cthread (ct);
+  lock_release (&ct_lock);
+  return status;
 }
 
-/* Free the current process's resources. */
+/* Waits for any child of the running process to die, stores its
+   exit status into *STATUS, and returns its thread id.  Returns
+   TID_ERROR immediately if there are no children left to wait
+   for. */
+tid_t
+process_wait_any (int *status) 
+{
+  struct thread *cur = process_current ();
+  tid_t tid = TID_ERROR;
+
+  lock_acquire (&ct_lock);
+  while (!list_empty (&cur->ct_list)) 
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&cur->ct_list); e != list_end (&cur->ct_list);
+           e = list_next (e)) 
+        {
+          struct cthread *ct = list_entry (e, struct cthread, ctelem);
+          if (ct->exited) 
+            {
+              list_remove (e);
+              tid = ct->tid;
+              *status = ct->exit_status;
+              put_cthread (ct);
+              break;
+            }
+        }
+      if (tid != TID_ERROR || cur->exiting)
+        break;
+      cond_wait (&cur->child_exited, &ct_lock);
+    }
+  lock_release (&ct_lock);
+  return tid;
+}
+
+/* Free the current process's resources.  A thread other than
+   its process's leader frees only its own; the leader waits for
+   the others to exit and then frees what they shared. */
 void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
+  struct cthread *ct = cur->cstatus;
   uint32_t *pd;
 
+  if (cur->leader != cur) 
+    {
+      exit_thread ();
+      return;
+    }
+
+  /* Make our other threads die, and wait until they have. */
+  process_begin_exit (-1);
+  lock_acquire (&ut_lock);
+  while (cur->thread_cnt > 1) 
+    {
+      lock_release (&ut_lock);
+      sema_down (&cur->threads_gone);
+      lock_acquire (&ut_lock);
+    }
+  while (!list_empty (&cur->uthreads))
+    free (list_entry (list_pop_front (&cur->uthreads),
+                      struct uthread, elem));
+  lock_release (&ut_lock);
+
+  /* Close our descriptors before telling our parent we're done,
+     so that a parent reading from our pipe sees end of file by
+     the time wait() returns. */
+  syscall_close_fds ();
+
+  /* Publish our exit status first, so that our parent's wait()
+     can return while we are still cleaning up.  Then let our
+     children know that nobody will wait for them. */
+  lock_acquire (&ct_lock);
+  if (ct != NULL) 
+    {
+      ct->exit_status = cur->exit_status;
+      ct->exited = true;
+      if (ct->parent != NULL)
+        cond_broadcast (&ct->parent->child_exited, &ct_lock);
+      put_cthread (ct);
+      cur->cstatus = NULL;
+    }
+  while (!list_empty (&cur->ct_list)) 
+    {
+      ct = list_entry (list_pop_front (&cur->ct_list),
+                       struct cthread, ctelem);
+      ct->parent = NULL;
+      put_cthread (ct);
+    }
+  lock_release (&ct_lock);
+
+  /* Unmap shared memory, whose frames are not ours to free. */
+  if (cur->pagedir != NULL)
+    shm_unmap_all ();
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -223,12 +465,14 @@ process_exit (void)
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
          process page directory.  We must activate the base page
-         directory before destroying the process's page
+         directory before releasing the process's page
          directory, or our active page directory will be one
-         that's been freed (and cleared). */
+         that's been freed (and cleared).  The reaper thread
+         frees its pages later, so our parent's wait() doesn't
+         have to wait for that too. */
       cur->pagedir = NULL;
       pagedir_activate (NULL);
-      pagedir_destroy (pd);
+      pagedir_release (pd);
     }
 }
 
@@ -240,14 +484,260 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread keeps
+     whatever page directory was active, since it only needs
+     the kernel mappings that all of them share. */
+  pagedir_switch (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
   tss_update ();
 }
-
+
+/* Marks the running process as exiting with STATUS, so that its
+   other threads die the next time they would return to user mode,
+   and wakes those sleeping in the kernel so that they get that
+   chance: on futexes, in wait(), and on the EXIT_WAITS queue,
+   where pipe, console and poll() waits sleep too.  Returns false,
+   ignoring STATUS, if the process was already exiting. */
+bool
+process_begin_exit (int status) 
+{
+  struct thread *leader = process_current ();
+  bool first;
+
+  lock_acquire (&ut_lock);
+  first = !leader->exiting;
+  if (first) 
+    {
+      leader->exiting = true;
+      leader->exit_status = status;
+    }
+  lock_release (&ut_lock);
+  if (first) 
+    {
+      if (leader->pagedir != NULL)
+        futex_wake_process (leader);
+      wait_queue_wake (&leader->exit_waits);
+      lock_acquire (&ct_lock);
+      cond_broadcast (&leader->child_exited, &ct_lock);
+      lock_release (&ct_lock);
+    }
+  return first;
+}
+
+/* Ends the running thread if its process is exiting.  Called
+   whenever an interrupt is about to return to user mode. */
+void
+process_check_exit (void) 
+{
+  if (process_current ()->exiting) 
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+}
+
+/* Returns the user page that holds the stack of the thread in
+   stack slot SLOT. */
+static void *
+stack_page (int slot) 
+{
+  return (uint8_t *) PHYS_BASE - slot * UTHREAD_STACK_SPACING - PGSIZE;
+}
+
+/* Starts a new thread in the running process.  It begins at user
+   address EIP, on a fresh one-page stack, as if EIP had been
+   called with FUNCTION and AUX as arguments.  Returns the new
+   thread's tid, or TID_ERROR if it could not be created. */
+tid_t
+process_thread_create (void (*eip) (void), void *function, void *aux) 
+{
+  struct thread *leader = process_current ();
+  struct thread_info info;
+  struct uthread *ut;
+  uint32_t *frame;
+  uint8_t *kpage;
+  tid_t tid = TID_ERROR;
+  int slot;
+
+  ut = malloc (sizeof *ut);
+  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (ut == NULL || kpage == NULL)
+    goto fail;
+
+  /* Claim a stack slot, unless the process is on its way out. */
+  lock_acquire (&ut_lock);
+  for (slot = 1; slot < UTHREAD_MAX; slot++)
+    if ((leader->stack_slots & (1u << slot)) == 0)
+      break;
+  if (leader->exiting || slot >= UTHREAD_MAX) 
+    {
+      lock_release (&ut_lock);
+      goto fail;
+    }
+  leader->stack_slots |= 1u << slot;
+  leader->thread_cnt++;
+  ut->tid = TID_ERROR;
+  ut->slot = slot;
+  sema_init (&ut->done, 0);
+  list_push_back (&leader->uthreads, &ut->elem);
+  lock_release (&ut_lock);
+
+  /* Lay out the stack for a call to EIP (FUNCTION, AUX) from a
+     null return address, and map it. */
+  frame = (uint32_t *) (kpage + PGSIZE) - 3;
+  frame[0] = 0;
+  frame[1] = (uint32_t) function;
+  frame[2] = (uint32_t) aux;
+  lock_acquire (&leader->proc_lock);
+  if (pagedir_get_page (leader->pagedir, stack_page (slot)) == NULL
+      && pagedir_set_page (leader->pagedir, stack_page (slot), kpage, true)) 
+    {
+      info.leader = leader;
+      info.uthread = ut;
+      info.eip = eip;
+      info.esp = (uint8_t *) stack_page (slot) + PGSIZE - 3 * sizeof *frame;
+      sema_init (&info.started, 0);
+      tid = thread_create (leader->name, PRI_DEFAULT, start_thread, &info);
+      if (tid == TID_ERROR)
+        pagedir_clear_page (leader->pagedir, stack_page (slot));
+    }
+  lock_release (&leader->proc_lock);
+  if (tid != TID_ERROR) 
+    {
+      sema_down (&info.started);
+      return tid;
+    }
+
+  /* Give back the slot. */
+  lock_acquire (&ut_lock);
+  list_remove (&ut->elem);
+  leader->stack_slots &= ~(1u << slot);
+  if (--leader->thread_cnt == 1)
+    sema_up (&leader->threads_gone);
+  lock_release (&ut_lock);
+
+ fail:
+  free (ut);
+  palloc_free_page (kpage);
+  return TID_ERROR;
+}
+
+/* A thread function that joins the process described by INFO_
+   and starts running user code. */
+static void
+start_thread (void *info_)
+{
+  struct thread_info *info = info_;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_;
+
+  cur->leader = info->leader;
+  cur->uthread = info->uthread;
+  cur->uthread->tid = cur->tid;
+  cur->pagedir = info->leader->pagedir;
+  process_activate ();
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = info->eip;
+  if_.esp = info->esp;
+
+  /* INFO is on our creator's stack, so let it go only now. */
+  sema_up (&info->started);
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Waits for thread TID of the running process to exit.  Returns
+   0 if successful, -1 if TID is not such a thread, is the caller,
+   or has already been joined. */
+int
+process_thread_join (tid_t tid) 
+{
+  struct thread *leader = process_current ();
+  struct uthread *ut = NULL;
+  struct list_elem *e;
+
+  if (tid == thread_tid ())
+    return -1;
+
+  lock_acquire (&ut_lock);
+  for (e = list_begin (&leader->uthreads); e != list_end (&leader->uthreads);
+       e = list_next (e))
+    if (list_entry (e, struct uthread, elem)->tid == tid) 
+      {
+        ut = list_entry (e, struct uthread, elem);
+        list_remove (e);
+        break;
+      }
+  lock_release (&ut_lock);
+  if (ut == NULL)
+    return -1;
+
+  sema_down (&ut->done);
+  free (ut);
+  return 0;
+}
+
+/* Ends the running thread.  If it is the process's leader, the
+   process exits with status 0 once its other threads have. */
+void
+process_thread_exit (void) 
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->leader == cur) 
+    {
+      lock_acquire (&ut_lock);
+      while (cur->thread_cnt > 1) 
+        {
+          lock_release (&ut_lock);
+          sema_down (&cur->threads_gone);
+          lock_acquire (&ut_lock);
+        }
+      lock_release (&ut_lock);
+      exit (0);
+    }
+  thread_exit ();
+}
+
+/* Frees what belongs to the running thread alone, which is not
+   its process's leader, and tells the leader and any joiner that
+   it is gone. */
+static void
+exit_thread (void) 
+{
+  struct thread *cur = thread_current ();
+  struct thread *leader = cur->leader;
+  struct uthread *ut = cur->uthread;
+  void *kpage;
+
+  if (cur->pagedir != NULL) 
+    {
+      lock_acquire (&leader->proc_lock);
+      kpage = pagedir_get_page (cur->pagedir, stack_page (ut->slot));
+      pagedir_clear_page (cur->pagedir, stack_page (ut->slot));
+      lock_release (&leader->proc_lock);
+      palloc_free_page (kpage);
+
+      /* The page directory is the leader's to destroy.  Stop
+         using it before the leader can. */
+      cur->pagedir = NULL;
+      pagedir_activate (NULL);
+    }
+
+  lock_acquire (&ut_lock);
+  leader->stack_slots &= ~(1u << ut->slot);
+  sema_up (&ut->done);
+  if (--leader->thread_cnt == 1)
+    sema_up (&leader->threads_gone);
+  lock_release (&ut_lock);
+}
+
 /* We load ELF binaries.  The following definitions are taken
    from the ELF specification, [ELF1], more-or-less verbatim.  */
 
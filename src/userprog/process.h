@@ -8,9 +8,19 @@ struct PCB {
     int error_code;
 };
 
+void process_init (void);
+struct thread *process_current (void);
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
+tid_t process_wait_any (int *status);
 void process_exit (void);
 void process_activate (void);
 
+/* Threads within a process. */
+bool process_begin_exit (int status);
+void process_check_exit (void);
+tid_t process_thread_create (void (*eip) (void), void *function, void *aux);
+int process_thread_join (tid_t);
+void process_thread_exit (void) NO_RETURN;
+
 #endif /* userprog/process.h */
@@ -0,0 +1,258 @@
+#include "userprog/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+
+/* Shared memory segments.
+
+   A segment is a set of user-pool frames that any number of
+   processes can map into their address spaces, at addresses of
+   their choosing, with pagedir_set_page().  Processes find a
+   segment by an integer key passed to shm_open(), which returns a
+   handle that the system call layer keeps in a file descriptor,
+   so that it is inherited across exec like any other.
+
+   A segment is reference counted: each open handle and each
+   mapping holds one reference.  The frames are freed when the
+   last reference goes away, so a segment outlives the
+   descriptors used to map it for as long as it stays mapped. */
+
+/* Maximum size of a segment, in pages. */
+#define SHM_MAX_PAGES 1024
+
+struct shm
+  {
+    int key;                    /* Key, or 0 if private. */
+    size_t page_cnt;            /* Number of pages. */
+    void **frames;              /* Kernel addresses of frames. */
+    int ref_cnt;                /* Handles plus mappings. */
+    struct list_elem elem;      /* Element in shm_list. */
+  };
+
+/* A mapping of a segment into a process, in its shm_maps list. */
+struct shm_mapping
+  {
+    void *addr;                 /* User address of first page. */
+    struct shm *shm;            /* Segment mapped there. */
+    struct list_elem elem;      /* Element in thread's shm_maps. */
+  };
+
+/* Segments with nonzero keys. */
+static struct list shm_list;
+
+/* Protects shm_list and every segment's reference count. */
+static struct lock shm_lock;
+
+static void put_shm (struct shm *);
+static void unmap_pages (uint32_t *pd, void *addr, size_t page_cnt);
+
+/* Initializes the shared memory segments. */
+void
+shm_init (void) 
+{
+  list_init (&shm_list);
+  lock_init (&shm_lock);
+}
+
+/* Returns a handle for the segment with the given KEY, creating
+   it with room for SIZE bytes if there is none.  KEY 0 always
+   creates a new segment, which no other shm_open() call can
+   find.  Returns a null pointer if an existing segment is smaller
+   than SIZE, if SIZE is 0 or too large, or if memory is short. */
+struct shm *
+shm_open (int key, size_t size) 
+{
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  struct shm *shm;
+  struct list_elem *e;
+  size_t i;
+
+  if (page_cnt == 0 || page_cnt > SHM_MAX_PAGES)
+    return NULL;
+
+  lock_acquire (&shm_lock);
+  if (key != 0)
+    for (e = list_begin (&shm_list); e != list_end (&shm_list);
+         e = list_next (e)) 
+      {
+        shm = list_entry (e, struct shm, elem);
+        if (shm->key == key) 
+          {
+            if (shm->page_cnt < page_cnt)
+              shm = NULL;
+            else
+              shm->ref_cnt++;
+            lock_release (&shm_lock);
+            return shm;
+          }
+      }
+
+  /* Create a new segment, with zeroed frames. */
+  shm = malloc (sizeof *shm);
+  if (shm == NULL)
+    goto fail;
+  shm->frames = calloc (page_cnt, sizeof *shm->frames);
+  if (shm->frames == NULL)
+    goto fail;
+  shm->key = key;
+  shm->page_cnt = page_cnt;
+  shm->ref_cnt = 1;
+  for (i = 0; i < page_cnt; i++) 
+    {
+      shm->frames[i] = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (shm->frames[i] == NULL)
+        goto fail;
+    }
+  if (key != 0)
+    list_push_back (&shm_list, &shm->elem);
+  lock_release (&shm_lock);
+  return shm;
+
+ fail:
+  if (shm != NULL && shm->frames != NULL) 
+    {
+      for (i = 0; i < page_cnt; i++)
+        palloc_free_page (shm->frames[i]);
+      free (shm->frames);
+    }
+  free (shm);
+  lock_release (&shm_lock);
+  return NULL;
+}
+
+/* Adds a handle for SHM, for a copied descriptor. */
+void
+shm_dup (struct shm *shm) 
+{
+  lock_acquire (&shm_lock);
+  shm->ref_cnt++;
+  lock_release (&shm_lock);
+}
+
+/* Closes a handle for SHM, freeing it if nothing else refers to
+   it. */
+void
+shm_close (struct shm *shm) 
+{
+  lock_acquire (&shm_lock);
+  put_shm (shm);
+  lock_release (&shm_lock);
+}
+
+/* Maps SHM into the running process starting at ADDR, which must
+   be page-aligned and followed by enough unmapped user pages to
+   hold all of SHM.  Returns ADDR, or a null pointer on failure.
+   The caller must hold the process's proc_lock, as for
+   shm_unmap(). */
+void *
+shm_map (struct shm *shm, void *addr) 
+{
+  struct thread *cur = process_current ();
+  struct shm_mapping *m;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0
+      || (uintptr_t) addr + shm->page_cnt * PGSIZE > (uintptr_t) PHYS_BASE
+      || (uintptr_t) addr + shm->page_cnt * PGSIZE < (uintptr_t) addr)
+    return NULL;
+  for (i = 0; i < shm->page_cnt; i++)
+    if (pagedir_get_page (cur->pagedir, (uint8_t *) addr + i * PGSIZE))
+      return NULL;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return NULL;
+  for (i = 0; i < shm->page_cnt; i++)
+    if (!pagedir_set_page (cur->pagedir, (uint8_t *) addr + i * PGSIZE,
+                           shm->frames[i], true)) 
+      {
+        unmap_pages (cur->pagedir, addr, i);
+        free (m);
+        return NULL;
+      }
+
+  shm_dup (shm);
+  m->addr = addr;
+  m->shm = shm;
+  list_push_back (&cur->shm_maps, &m->elem);
+  return addr;
+}
+
+/* Unmaps the segment that the running process mapped at ADDR.
+   Returns false if there is no such mapping. */
+bool
+shm_unmap (void *addr) 
+{
+  struct thread *cur = process_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->shm_maps); e != list_end (&cur->shm_maps);
+       e = list_next (e)) 
+    {
+      struct shm_mapping *m = list_entry (e, struct shm_mapping, elem);
+      if (m->addr == addr) 
+        {
+          list_remove (e);
+          unmap_pages (cur->pagedir, m->addr, m->shm->page_cnt);
+          shm_close (m->shm);
+          free (m);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Unmaps every segment mapped by the running process.  Must be
+   called before its page directory is destroyed, which would
+   otherwise free the shared frames. */
+void
+shm_unmap_all (void) 
+{
+  struct thread *cur = process_current ();
+
+  while (!list_empty (&cur->shm_maps)) 
+    {
+      struct shm_mapping *m = list_entry (list_front (&cur->shm_maps),
+                                          struct shm_mapping, elem);
+      shm_unmap (m->addr);
+    }
+}
+
+/* Drops a reference to SHM, freeing it and its frames if that
+   was the last.  The caller must hold shm_lock. */
+static void
+put_shm (struct shm *shm) 
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&shm_lock));
+  ASSERT (shm->ref_cnt > 0);
+
+  if (--shm->ref_cnt > 0)
+    return;
+  if (shm->key != 0)
+    list_remove (&shm->elem);
+  for (i = 0; i < shm->page_cnt; i++)
+    palloc_free_page (shm->frames[i]);
+  free (shm->frames);
+  free (shm);
+}
+
+/* Removes the mappings for the PAGE_CNT pages starting at ADDR
+   from PD, without freeing the frames behind them. */
+static void
+unmap_pages (uint32_t *pd, void *addr, size_t page_cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    pagedir_clear_page (pd, (uint8_t *) addr + i * PGSIZE);
+}
@@ -0,0 +1,17 @@
+#ifndef USERPROG_SHM_H
+#define USERPROG_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct shm;
+
+void shm_init (void);
+struct shm *shm_open (int key, size_t size);
+void shm_dup (struct shm *);
+void shm_close (struct shm *);
+void *shm_map (struct shm *, void *addr);
+bool shm_unmap (void *addr);
+void shm_unmap_all (void);
+
+#endif /* userprog/shm.h */
@@ -1,27 +1,68 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include "lib/kernel/stdio.h"
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "userprog/pagedir.h"
 #include "threads/vaddr.h"
 #include "threads/init.h"
+#include <fcntl.h>
+#include <poll.h>
+#include "devices/input.h"
+#include "devices/timer.h"
 #include "devices/shutdown.h"
 #include "process.h"
+#include "userprog/pipe.h"
+#include "userprog/shm.h"
+#include "userprog/futex.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 
 typedef int pid_t;
 
-// fd与文件对应
+// fd与文件对应.  A descriptor refers to a FILE, to one end of a
+// PIPE, to a shared memory segment SHM, or, if all three are
+// null, to the console.  Descriptors 0 and 1 mean the console
+// unless the process has an entry for them, made by dup2() or by
+// fcntl().
 struct file_fd
 {
   struct file *file;
+  struct pipe *pipe;
+  bool pipe_writer;          // Write end of PIPE?
+  struct shm *shm;
+  bool nonblock;             // O_NONBLOCK: fail instead of waiting
+  bool cloexec;              // FD_CLOEXEC: not inherited across exec
+  int console_fd;            // Console entry: 0 to read or 1 to write
   int fd;
   struct list_elem file_elem;
 };
 
+/* A descriptor that poll() is watching, with the wait queue entry
+   it put on the object behind it. */
+struct poll_slot
+{
+  struct wait_entry entry;
+  struct pipe *pipe;         // Pipe we hold a reference to, if any.
+  bool pipe_writer;
+};
+
+/* A poll() in progress. */
+struct poller
+{
+  struct semaphore wakeup;   // Upped by wait queues and the timeout.
+  struct timer_event timeout;
+  bool timed_out;
+};
+
+/* Bytes a pipe read or write moves per chunk.  The data passes
+   through a buffer of this size on the kernel stack. */
+#define PIPE_CHUNK 256
+
 struct write_thread
 {
     struct thread *t;
@@ -30,19 +71,47 @@ struct write_thread
 
 static struct write_thread *wt;
 
+/* Cache of struct file_fd. */
+static struct kmem_cache *file_fd_cache;
+
 static void syscall_handler (struct intr_frame *);
 static void halt(void);
 static pid_t exec (char *cmd_line);
 static int wait (pid_t pid);
+static pid_t wait_any (int *status);
 static bool create (char *file, int initial_size);
 static bool remove (char *file);
 static int open (char *file);
 static int filesize (int fd);
 static int read (int fd, void* buffer, unsigned size);
 static int write(int fd, void* buffer, unsigned size);
+static int read_pipe (int fd, uint8_t *buffer, unsigned size);
+static int write_pipe (int fd, const uint8_t *buffer, unsigned size);
+static struct pipe *get_pipe (int fd, bool writer, bool *nonblock);
+static bool wait_pipe (struct pipe *pipe, bool writer);
+static bool wait_input (void);
+static bool sleep_or_exit (struct semaphore *wakeup);
 static unsigned tell (int fd);
 static void seek (int fd, unsigned position);
 static void close (int fd);
+static void close_fd (int fd);
+static int pipe (int *fds);
+static int dup2 (int oldfd, int newfd);
+static int sys_shm_open (int key, unsigned size);
+static void *sys_shm_map (int fd, void *addr);
+static bool sys_shm_unmap (void *addr);
+static tid_t sys_thread_create (void *eip, void *function, void *aux);
+static bool sys_futex_wait (int *addr, int expected);
+static int fcntl (int fd, int cmd, int arg);
+static int poll (struct pollfd *fds, unsigned nfds, int timeout);
+static int poll_fd (struct pollfd *pfd, struct poll_slot *slot,
+                    struct semaphore *wakeup);
+static void poll_timeout (void *poller_);
+static int sys_futex_wake (int *addr, int cnt);
+static struct file_fd *lookup_fd (int fd);
+static void fd_dup (struct file_fd *ff);
+static void fd_release (struct file_fd *ff);
+static bool check_buffer (const void *buffer, unsigned size);
 static int get_user (const uint8_t *uaddr);
 static bool put_user (uint8_t *udst, uint8_t byte);
 
@@ -51,6 +120,133 @@ syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
   lock_init (&rox_lock);
+  shm_init ();
+  file_fd_cache = kmem_cache_create ("file_fd", sizeof (struct file_fd),
+                                     NULL);
+}
+
+static bool isBad (const void *p);
+
+/* Returns the current process's descriptor FD, or NULL if it has
+   no such descriptor.  Descriptors 0 and 1 are usually not in the
+   list: they mean the console.  The process's threads share its
+   descriptors, so the caller must hold its proc_lock. */
+static struct file_fd *
+lookup_fd (int fd)
+{
+  struct thread *p = process_current ();
+  struct list *fds = &p->file_list;
+
+  ASSERT (lock_held_by_current_thread (&p->proc_lock));
+  struct list_elem *e;
+  for (e = list_begin (fds); e != list_end (fds); e = list_next (e))
+    {
+      struct file_fd *ff = list_entry (e, struct file_fd, file_elem);
+      if (ff->fd == fd)
+        return ff;
+    }
+  return NULL;
+}
+
+/* Returns true if every page of the SIZE bytes at BUFFER is
+   mapped in the current process.  Needed before touching user
+   memory where a page fault can't be survived: with interrupts
+   off, or with a lock held. */
+static bool
+check_buffer (const void *buffer, unsigned size)
+{
+  const char *p = buffer, *end = p + size;
+  // SIZE过大时END会回绕, 循环就什么也不检查了
+  if ((uintptr_t) buffer > (uintptr_t) PHYS_BASE
+      || size > (uintptr_t) PHYS_BASE - (uintptr_t) buffer)
+    return false;
+  for (; p < end; p = (const char*)pg_round_down (p) + PGSIZE)
+    if (isBad (p))
+      return false;
+  return true;
+}
+
+/* Takes another reference to what FF refers to, for a copy of a
+   descriptor.  A file is shared, not reopened, so the copy moves
+   the same position, as after dup2() in Unix. */
+static void
+fd_dup (struct file_fd *ff)
+{
+  if (ff->pipe != NULL)
+    pipe_dup (ff->pipe, ff->pipe_writer);
+  else if (ff->shm != NULL)
+    shm_dup (ff->shm);
+  else if (ff->file != NULL)
+    file_dup (ff->file);
+}
+
+/* Drops FF's reference to what it refers to. */
+static void
+fd_release (struct file_fd *ff)
+{
+  if (ff->pipe != NULL)
+    pipe_close (ff->pipe, ff->pipe_writer);
+  else if (ff->shm != NULL)
+    shm_close (ff->shm);
+  else if (ff->file != NULL)
+    file_close (ff->file);
+}
+
+/* Returns true if FF, which may be null, is descriptor FD and
+   refers to the console in the direction CONSOLE_FD, which is 0
+   for reading or 1 for writing.  Without an entry, FD itself
+   gives the direction; an entry made by fcntl() remembers it,
+   and copies made by dup2() keep it. */
+static bool
+is_console (struct file_fd *ff, int fd, int console_fd)
+{
+  if (ff == NULL)
+    return fd == console_fd;
+  return (ff->file == NULL && ff->pipe == NULL && ff->shm == NULL
+          && ff->console_fd == console_fd);
+}
+
+/* Copies the parent's descriptors, except those marked
+   FD_CLOEXEC, into the running process, which PARENT, a thread
+   of the parent process, has just exec'd. */
+void
+syscall_inherit_fds (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  parent = parent->leader;
+  for (e = list_begin (&parent->file_list); e != list_end (&parent->file_list);
+       e = list_next (e))
+    {
+      struct file_fd *pf = list_entry (e, struct file_fd, file_elem);
+      if (pf->cloexec)
+        continue;
+      struct file_fd *ff = kmem_cache_alloc (file_fd_cache);
+      if (ff == NULL)
+        break;
+      *ff = *pf;
+      fd_dup (ff);
+      list_push_back (&cur->file_list, &ff->file_elem);
+    }
+  cur->fd = parent->fd;
+}
+
+/* Closes all of the running process's descriptors, so that pipe
+   readers see end of file once their writers have exited.  Called
+   by the process's leader once its other threads are gone. */
+void
+syscall_close_fds (void)
+{
+  struct list *fds = &thread_current ()->file_list;
+
+  while (!list_empty (fds))
+    {
+      struct file_fd *ff = list_entry (list_pop_front (fds),
+                                       struct file_fd, file_elem);
+      fd_release (ff);
+      kmem_cache_free (file_fd_cache, ff);
+    }
 }
 
 static bool isBad (const void *p)
@@ -95,6 +291,8 @@ syscall_handler (struct intr_frame *f UNUSED)
   }
   
   // printf ("%%esp: %p, [%%esp]: %d", f->esp, *(int*)f->esp);
+  thread_current ()->acct.syscall_cnt++;
+
   // cast f->esp into an int*, then dereference it for the SYS_CODE
   switch(*(int*)f->esp)
   {
@@ -129,6 +327,13 @@ syscall_handler (struct intr_frame *f UNUSED)
       f->eax = wait(pid);
       break;
     }
+    case SYS_WAIT_ANY:
+    {
+      // Implement syscall WAIT_ANY
+      int *status = (int *)(*((int*)f->esp + 1));
+      f->eax = wait_any (status);
+      break;
+    }
     case SYS_CREATE:
     {
       // Implement syscall CREATE
@@ -198,6 +403,106 @@ syscall_handler (struct intr_frame *f UNUSED)
       close(fd);
       break;
     }
+    case SYS_PIPE:
+    {
+      // Implement syscall PIPE
+      int *fds = (int *)(*((int*)f->esp + 1));
+      f->eax = pipe (fds);
+      break;
+    }
+    case SYS_DUP2:
+    {
+      // Implement syscall DUP2
+      int oldfd = *((int*)f->esp + 1);
+      int newfd = *((int*)f->esp + 2);
+      f->eax = dup2 (oldfd, newfd);
+      break;
+    }
+    case SYS_SHM_OPEN:
+    {
+      // Implement syscall SHM_OPEN
+      int key = *((int*)f->esp + 1);
+      unsigned size = *((unsigned*)f->esp + 2);
+      f->eax = sys_shm_open (key, size);
+      break;
+    }
+    case SYS_SHM_MAP:
+    {
+      // Implement syscall SHM_MAP
+      int fd = *((int*)f->esp + 1);
+      void *addr = (void*)(*((int*)f->esp + 2));
+      f->eax = (uint32_t) sys_shm_map (fd, addr);
+      break;
+    }
+    case SYS_SHM_UNMAP:
+    {
+      // Implement syscall SHM_UNMAP
+      void *addr = (void*)(*((int*)f->esp + 1));
+      f->eax = sys_shm_unmap (addr);
+      break;
+    }
+    case SYS_THREAD_CREATE:
+    {
+      // Implement syscall THREAD_CREATE
+      void *eip = (void*)(*((int*)f->esp + 1));
+      void *function = (void*)(*((int*)f->esp + 2));
+      void *aux = (void*)(*((int*)f->esp + 3));
+      f->eax = sys_thread_create (eip, function, aux);
+      break;
+    }
+    case SYS_THREAD_JOIN:
+    {
+      // Implement syscall THREAD_JOIN
+      tid_t tid = *((tid_t*)f->esp + 1);
+      f->eax = process_thread_join (tid);
+      break;
+    }
+    case SYS_THREAD_EXIT:
+    {
+      // Implement syscall THREAD_EXIT
+      process_thread_exit ();
+      break;
+    }
+    case SYS_FUTEX_WAIT:
+    {
+      // Implement syscall FUTEX_WAIT
+      int *addr = (int *)(*((int*)f->esp + 1));
+      int expected = *((int*)f->esp + 2);
+      f->eax = sys_futex_wait (addr, expected);
+      break;
+    }
+    case SYS_FUTEX_WAKE:
+    {
+      // Implement syscall FUTEX_WAKE
+      int *addr = (int *)(*((int*)f->esp + 1));
+      int cnt = *((int*)f->esp + 2);
+      f->eax = sys_futex_wake (addr, cnt);
+      break;
+    }
+    case SYS_FCNTL:
+    {
+      // Implement syscall FCNTL
+      int fd = *((int*)f->esp + 1);
+      int cmd = *((int*)f->esp + 2);
+      int arg = *((int*)f->esp + 3);
+      f->eax = fcntl (fd, cmd, arg);
+      break;
+    }
+    case SYS_POLL:
+    {
+      // Implement syscall POLL
+      struct pollfd *fds = (struct pollfd *)(*((int*)f->esp + 1));
+      unsigned nfds = *((unsigned*)f->esp + 2);
+      int timeout = *((int*)f->esp + 3);
+      f->eax = poll (fds, nfds, timeout);
+      break;
+    }
+    case SYS_SCHEDSTAT:
+    {
+      // Dump per-thread CPU accounting and the scheduler trace
+      thread_print_sched_stats ();
+      break;
+    }
     default:
       exit (-1);
   }
@@ -210,23 +515,10 @@ static void halt (void)
 
 void exit (int status) 
 {
-  printf ("%s: exit(%d)\n", thread_current()->name, status);
-  struct list_elem *e;
-  struct thread *t = thread_current ();
-  for (e = list_begin (&t->parent->ct_list); e != list_end (&t->parent->ct_list);
-      e = list_next (e))
-    {
-      struct cthread *ct = list_entry (e, struct cthread, ctelem);
-      if (ct->cthread->tid == t->tid) 
-        {
-          ct->exit_status = status;
-          break;
-        }     
-    }
-    
-  if (thread_current()->parent->cur_waitpid == thread_current()->tid)
-    sema_up(&thread_current()->parent->some_semaphore);
-
+  // 进程中第一个调用exit()的线程决定退出状态; 其他线程随后退出.
+  // process_exit() hands the status to our parent
+  if (process_begin_exit (status))
+    printf ("%s: exit(%d)\n", thread_current()->name, status);
   thread_exit();
 }
 
@@ -243,41 +535,32 @@ static pid_t exec (char *cmd_line)
   // else
   //   file_close (f);
 
+  // The child copies our descriptors while we hold proc_lock.
+  struct thread *p = process_current ();
+  lock_acquire (&p->proc_lock);
   lock_acquire (&rox_lock);
   pid_t pid = process_execute (cmd_line);
   lock_release (&rox_lock);
+  lock_release (&p->proc_lock);
   return pid;
 }
 
 static int wait (pid_t pid) 
 {
-  if (thread_current()->cur_waitpid != 0)
-    return -1;
-  else 
-    thread_current()->cur_waitpid = (tid_t)pid;
-
-  //printf ("%d\n", pid);
-
-  struct list_elem *e;
-  bool isChild = false;
-
-  for (e = list_begin (&thread_current()->ct_list); e != list_end (&thread_current()->ct_list);
-      e = list_next (e))
-    {
-      struct cthread *ct = list_entry (e, struct cthread, ctelem);
-      if (ct->cthread->tid == (tid_t)pid)
-        isChild = true;
-    }
-  if (!isChild)
-    return -1;
-
-  // while (!sema_try_down(&thread_current()->some_semaphore)) 
-  //     if (process_wait((tid_t)pid) == -1)
-  //       break;
-  thread_current()->cur_waitpid = 0;
   return process_wait((tid_t)pid);
 }
 
+static pid_t wait_any (int *status)
+{
+  if (status != NULL && isBad (status))
+    exit (-1);
+  int child_status;
+  pid_t pid = process_wait_any (&child_status);
+  if (pid != TID_ERROR && status != NULL)
+    *status = child_status;
+  return pid;
+}
+
 static bool create (char *file, int initial_size) 
 {
   if (file == NULL)
@@ -307,187 +590,652 @@ static int open (char *file)
   }
   else
   {
-    thread_current ()->fd = thread_current ()->fd + 1;
-    int fd = thread_current ()->fd;
-    struct file_fd *ff = malloc(sizeof(*ff));
+    struct thread *p = process_current ();
+    struct file_fd *ff = kmem_cache_alloc (file_fd_cache);
+    if (ff == NULL)
+    {
+      file_close (f);
+      return -1;
+    }
     ff->file = f;
-    ff->fd = fd;
-    list_push_back (&thread_current ()->file_list, &ff->file_elem);
+    ff->pipe = NULL;
+    ff->shm = NULL;
+    ff->nonblock = false;
+    ff->cloexec = false;
+    lock_acquire (&p->proc_lock);
+    ff->fd = ++p->fd;
+    list_push_back (&p->file_list, &ff->file_elem);
+    lock_release (&p->proc_lock);
     wt = malloc(sizeof(wt));
-    return fd;
+    return ff->fd;
   }
 }
 
 static int filesize (int fd) 
 {
-  if (fd > thread_current ()->fd)
-    return 0;
-  struct list_elem *e;
-  for (e = list_begin (&thread_current ()->file_list); e != list_end (&thread_current ()->file_list);
-       e = list_next (e))
-    {
-      struct file_fd *ff = list_entry (e, struct file_fd, file_elem);
-      if (ff->fd == fd)
-      {
-        return file_length (ff->file);
-      }
-    }
-    return 0;
+  struct thread *p = process_current ();
+  int size = 0;
+  lock_acquire (&p->proc_lock);
+  struct file_fd *ff = lookup_fd (fd);
+  if (ff != NULL && ff->file != NULL)
+    size = file_length (ff->file);
+  lock_release (&p->proc_lock);
+  return size;
 }
 
 static int read (int fd, void *buffer, unsigned size)
 {
-  
-  if (fd == 1 || fd > thread_current ()->fd)
-    return -1;
-  if (isBad (buffer))
+  struct thread *p = process_current ();
+  // 先检查缓冲区: 持有proc_lock时不能发生页错误
+  if (isBad (buffer) || !check_buffer (buffer, size))
     exit (-1);
-  int i = 0;
-  if (fd == 0)
+
+  lock_acquire (&p->proc_lock);
+  struct file_fd *pf = lookup_fd (fd);
+  if (pf != NULL && pf->pipe != NULL)
   {
-    // Read from stdin
-    char *buffer = buffer;
-    while (i < size)
-    {
-      uint8_t key = input_getc();
-      //memset ((char*)buffer, key, 1);
-      buffer[i] = key;
-      i++;
-    }
-    return size;
+    bool writer = pf->pipe_writer;
+    lock_release (&p->proc_lock);
+    return writer ? -1 : read_pipe (fd, buffer, size);
   }
-  else
+  if (pf == NULL || pf->file == NULL)
   {
-    struct list_elem *e;
-    struct file *f = NULL;
-    for (e = list_begin (&thread_current ()->file_list); e != list_end (&thread_current ()->file_list);
-       e = list_next (e))
-    {
-      struct file_fd *ff = list_entry (e, struct file_fd, file_elem);
-      if (ff->fd == fd)
-      {
-        f = ff->file;
-        break;
-      }
-    }
-    if (f == NULL)
+    bool console = is_console (pf, fd, 0);
+    bool nonblock = pf != NULL && pf->nonblock;
+    lock_release (&p->proc_lock);
+    if (!console)
+      return -1;
+
+    /* Read from stdin: whatever has already arrived, after
+       waiting for at least one key, or failing if NONBLOCK.
+       input_read() works with interrupts off, so it fills a
+       kernel buffer and the copy into user memory happens
+       afterward. */
+    char keys[256];
+    size_t cnt;
+
+    if (size == 0)
+      return 0;
+    if (size > sizeof keys)
+      size = sizeof keys;
+    while ((cnt = input_read_nonblock (keys, size)) == 0 && !nonblock
+           && wait_input ())
+      continue;
+    if (cnt == 0)
       return -1;
-    lock_acquire (&rox_lock);
-    int res = file_read (f, buffer, size);
-    file_deny_write (f);
-    lock_release (&rox_lock);
-    return res;
+    memcpy (buffer, keys, cnt);
+    return cnt;
   }
+
+  struct file *f = pf->file;
+  lock_acquire (&rox_lock);
+  int res = file_read (f, buffer, size);
+  file_deny_write (f);
+  lock_release (&rox_lock);
+  lock_release (&p->proc_lock);
+  return res;
 }
 
 static int write (int fd, void* buffer, unsigned size) 
 {
-  if (fd == 1)
+  struct thread *p = process_current ();
+  /* We may hold proc_lock, where a page fault can't be survived,
+     so check every page now. */
+  if (isBad (buffer) || !check_buffer (buffer, size))
+    exit (-1);
+
+  lock_acquire (&p->proc_lock);
+  struct file_fd *pf = lookup_fd (fd);
+  if (pf != NULL && pf->pipe != NULL)
   {
-    putbuf ((char*)buffer, size);
+    bool writer = pf->pipe_writer;
+    lock_release (&p->proc_lock);
+    return writer ? write_pipe (fd, buffer, size) : -1;
+  }
+  if (pf == NULL || pf->file == NULL)
+  {
+    bool console = is_console (pf, fd, 1);
+    lock_release (&p->proc_lock);
+    if (!console)
+      return -1;
+
+    /* putbuf() may sleep holding the console lock while the
+       serial port drains, and meanwhile another thread could
+       unmap BUFFER, so copy it out a chunk at a time with no
+       locks held, as write_pipe() does. */
+    char data[PIPE_CHUNK];
+    unsigned done = 0;
+
+    while (done < size)
+    {
+      unsigned n = size - done < sizeof data ? size - done : sizeof data;
+      memcpy (data, (char*)buffer + done, n);
+      putbuf (data, n);
+      done += n;
+    }
     return size;
   }
-  if (fd == 0 || fd > thread_current ()->fd)
-    return -1;
-  if (isBad (buffer))
-    exit (-1);
-  else
+
+  struct file *f = pf->file;
+  lock_acquire (&rox_lock);
+  if (wt->file == f && wt->t == thread_current ())
+    file_allow_write (f);
+  int res = file_write (f, buffer, size);
+  wt->file = f;
+  wt->t = thread_current ();
+  //printf ("%d", res);
+  file_deny_write (f);
+  lock_release (&rox_lock);
+  lock_release (&p->proc_lock);
+  return res;
+}
+
+/* Reads up to SIZE bytes from the pipe open as FD into BUFFER:
+   whatever is there, after waiting for at least one byte unless
+   FD is nonblocking.  Returns the number of bytes read, 0 at end
+   of file, or -1.
+
+   Another thread may unmap BUFFER while we sleep, so the data
+   passes through a kernel buffer a chunk at a time, and we touch
+   BUFFER only while holding neither a lock nor a reference to the
+   pipe: the page fault then just kills us. */
+static int read_pipe (int fd, uint8_t *buffer, unsigned size)
+{
+  uint8_t data[PIPE_CHUNK];
+  unsigned done = 0;
+  int cnt = -1;
+
+  while (done < size)
   {
-    struct list_elem *e;
-    struct file *f = NULL;
-    for (e = list_begin (&thread_current ()->file_list); e != list_end (&thread_current ()->file_list);
-        e = list_next (e))
+    unsigned n = size - done < sizeof data ? size - done : sizeof data;
+    bool nonblock;
+    struct pipe *pipe = get_pipe (fd, false, &nonblock);
+    if (pipe == NULL)
+      break;
+    // 只为第一个字节等待
+    while ((cnt = pipe_read (pipe, data, n, true)) < 0
+           && !nonblock && done == 0 && wait_pipe (pipe, false))
+      continue;
+    pipe_close (pipe, false);
+    if (cnt <= 0)
+      break;
+    memcpy (buffer + done, data, cnt);
+    done += cnt;
+    if ((unsigned) cnt < n)
+      break;
+  }
+  return done > 0 || size == 0 ? (int) done : cnt;
+}
+
+/* Writes the SIZE bytes in BUFFER to the pipe open as FD, waiting
+   for room unless FD is nonblocking.  Returns the number of bytes
+   written, or -1 if none could be, because the read end is closed
+   everywhere or, if nonblocking, the pipe is full.  BUFFER is
+   copied a chunk at a time, for the same reason as in
+   read_pipe(). */
+static int write_pipe (int fd, const uint8_t *buffer, unsigned size)
+{
+  uint8_t data[PIPE_CHUNK];
+  unsigned done = 0;
+
+  while (done < size)
+  {
+    unsigned n = size - done < sizeof data ? size - done : sizeof data;
+    unsigned put = 0;
+    bool nonblock;
+    struct pipe *pipe;
+
+    memcpy (data, buffer + done, n);
+    pipe = get_pipe (fd, true, &nonblock);
+    if (pipe == NULL)
+      break;
+    while (put < n)
     {
-      struct file_fd *ff = list_entry (e, struct file_fd, file_elem);
-      if (ff->fd == fd)
-      {
-        f = ff->file;
+      int cnt = pipe_write (pipe, data + put, n - put, true);
+      if (cnt > 0)
+        put += cnt;
+      else if (nonblock || (pipe_poll (pipe, true, NULL, NULL) & POLLERR)
+               || !wait_pipe (pipe, true))
         break;
-      }
     }
-    if (f == NULL)
-      return -1;
-    lock_acquire (&rox_lock);
-    if (wt->file == f && wt->t == thread_current ())
-      file_allow_write (f);
-    int res = file_write (f, buffer, size);
-    wt->file = f;
-    wt->t = thread_current ();
-    //printf ("%d", res);
-    file_deny_write (f);
-    lock_release (&rox_lock);
-    return res;
+    pipe_close (pipe, true);
+    done += put;
+    if (put < n)
+      break;
   }
-  
+  return done > 0 || size == 0 ? (int) done : -1;
+}
+
+/* Returns the pipe open as FD, with a reference of our own that
+   the caller must drop with pipe_close(), or NULL if FD is not
+   open on the read end, or the write end if WRITER.  Stores FD's
+   O_NONBLOCK flag into *NONBLOCK. */
+static struct pipe *get_pipe (int fd, bool writer, bool *nonblock)
+{
+  struct thread *p = process_current ();
+  struct pipe *pipe = NULL;
+
+  lock_acquire (&p->proc_lock);
+  struct file_fd *ff = lookup_fd (fd);
+  if (ff != NULL && ff->pipe != NULL && ff->pipe_writer == writer)
+  {
+    pipe = ff->pipe;
+    *nonblock = ff->nonblock;
+    pipe_dup (pipe, writer);
+  }
+  lock_release (&p->proc_lock);
+  return pipe;
+}
+
+/* Waits until PIPE's read end, or its write end if WRITER, may be
+   ready.  Returns false if the process is exiting. */
+static bool wait_pipe (struct pipe *pipe, bool writer)
+{
+  struct semaphore wakeup;
+  struct wait_entry e;
+  bool ok = true;
+
+  // 先挂到等待队列上再检查, 以免漏掉其间的唤醒.
+  sema_init (&wakeup, 0);
+  if (pipe_poll (pipe, writer, &e, &wakeup) == 0)
+    ok = sleep_or_exit (&wakeup);
+  wait_queue_remove (&e);
+  return ok;
+}
+
+/* Waits until the console may have input.  Returns false if the
+   process is exiting. */
+static bool wait_input (void)
+{
+  struct semaphore wakeup;
+  struct wait_entry e;
+  bool ok = true;
+
+  sema_init (&wakeup, 0);
+  if (!input_poll (&e, &wakeup))
+    ok = sleep_or_exit (&wakeup);
+  wait_queue_remove (&e);
+  return ok;
+}
+
+/* Sleeps until WAKEUP is upped, which the caller has arranged to
+   happen when what it waits for may have changed, or until the
+   process starts to exit.  Returns false in the latter case: the
+   caller should give up, and the thread dies on its way back to
+   user mode. */
+static bool sleep_or_exit (struct semaphore *wakeup)
+{
+  struct thread *p = process_current ();
+  struct wait_entry e;
+
+  wait_queue_add (&p->exit_waits, &e, wakeup);
+  if (!p->exiting)
+    sema_down (wakeup);
+  wait_queue_remove (&e);
+  return !p->exiting;
 }
 
 static void seek (int fd, unsigned position) 
 {
-  if (fd > thread_current ()->fd)
-    return;
-  struct list_elem *e;
-  struct file *f = NULL;
-  for (e = list_begin (&thread_current ()->file_list); e != list_end (&thread_current ()->file_list);
-      e = list_next (e))
+  struct thread *p = process_current ();
+  lock_acquire (&p->proc_lock);
+  struct file_fd *ff = lookup_fd (fd);
+  if (ff != NULL && ff->file != NULL)
   {
-    struct file_fd *ff = list_entry (e, struct file_fd, file_elem);
-    if (ff->fd == fd)
-    {
-      f = ff->file;
-      break;
-    }
+    file_seek (ff->file, position);
+    file_allow_write (ff->file);
   }
-  if (f == NULL)
-    return;
-  file_seek (f, position);
-  file_allow_write (f);
-  return ;
+  lock_release (&p->proc_lock);
 }
 
 static unsigned tell (int fd)
 {
-  if (fd > thread_current ()->fd)
+  struct thread *p = process_current ();
+  unsigned pos = 0;
+  lock_acquire (&p->proc_lock);
+  struct file_fd *ff = lookup_fd (fd);
+  if (ff != NULL && ff->file != NULL)
+    pos = file_tell (ff->file);
+  lock_release (&p->proc_lock);
+  return pos;
+}
+
+static void close (int fd) 
+{
+  struct thread *p = process_current ();
+  lock_acquire (&p->proc_lock);
+  close_fd (fd);
+  lock_release (&p->proc_lock);
+}
+
+/* Closes FD.  The caller must hold the process's proc_lock. */
+static void close_fd (int fd)
+{
+  struct file_fd *ff = lookup_fd (fd);
+  if (ff == NULL)
     return;
-  struct list_elem *e;
-  struct file *f = NULL;
-  for (e = list_begin (&thread_current ()->file_list); e != list_end (&thread_current ()->file_list);
-      e = list_next (e))
+  list_remove (&ff->file_elem);
+  if (ff->file == NULL)
+  {
+    fd_release (ff);
+    kmem_cache_free (file_fd_cache, ff);
+    return;
+  }
+
+  struct file *f = ff->file;
+  kmem_cache_free (file_fd_cache, ff);
+  file_allow_write (f);
+  free (wt);
+  file_close (f);
+}
+
+/* Creates a pipe and stores descriptors for its read and write
+   ends into FDS[0] and FDS[1].  Returns 0 if successful, -1 if
+   memory is short. */
+static int pipe (int *fds)
+{
+  if (fds == NULL || !check_buffer (fds, 2 * sizeof *fds))
+    exit (-1);
+
+  struct thread *p = process_current ();
+  struct file_fd *rd = kmem_cache_alloc (file_fd_cache);
+  struct file_fd *wr = kmem_cache_alloc (file_fd_cache);
+  struct pipe *pp = rd != NULL && wr != NULL ? pipe_create () : NULL;
+  if (pp == NULL)
   {
-    struct file_fd *ff = list_entry (e, struct file_fd, file_elem);
-    if (ff->fd == fd)
+    kmem_cache_free (file_fd_cache, rd);
+    kmem_cache_free (file_fd_cache, wr);
+    return -1;
+  }
+
+  rd->file = wr->file = NULL;
+  rd->shm = wr->shm = NULL;
+  rd->pipe = wr->pipe = pp;
+  rd->pipe_writer = false;
+  wr->pipe_writer = true;
+  rd->nonblock = wr->nonblock = false;
+  rd->cloexec = wr->cloexec = false;
+  lock_acquire (&p->proc_lock);
+  rd->fd = ++p->fd;
+  wr->fd = ++p->fd;
+  list_push_back (&p->file_list, &rd->file_elem);
+  list_push_back (&p->file_list, &wr->file_elem);
+  lock_release (&p->proc_lock);
+  fds[0] = rd->fd;
+  fds[1] = wr->fd;
+  return 0;
+}
+
+/* Makes NEWFD refer to what OLDFD refers to, closing NEWFD first
+   if it is open.  NEWFD may be 0 or 1, to redirect the console,
+   or any descriptor number already handed out.  Closing NEWFD
+   later returns 0 or 1 to the console.  Returns NEWFD, or -1 on
+   failure. */
+static int dup2 (int oldfd, int newfd)
+{
+  struct thread *p = process_current ();
+  struct file_fd *ff = kmem_cache_alloc (file_fd_cache);
+  if (ff == NULL)
+    return -1;
+
+  lock_acquire (&p->proc_lock);
+  struct file_fd *old = lookup_fd (oldfd);
+  if (old == NULL || newfd < 0 || newfd > p->fd || oldfd == newfd)
+  {
+    lock_release (&p->proc_lock);
+    kmem_cache_free (file_fd_cache, ff);
+    return old != NULL && oldfd == newfd ? newfd : -1;
+  }
+  *ff = *old;
+  ff->cloexec = false;
+  fd_dup (ff);
+  close_fd (newfd);
+  ff->fd = newfd;
+  list_push_back (&p->file_list, &ff->file_elem);
+  lock_release (&p->proc_lock);
+  return newfd;
+}
+
+/* Opens the shared memory segment with the given KEY, creating
+   it with SIZE bytes if necessary, and returns a descriptor for
+   it, or -1 on failure.  See userprog/shm.c. */
+static int sys_shm_open (int key, unsigned size)
+{
+  struct thread *p = process_current ();
+  struct file_fd *ff = kmem_cache_alloc (file_fd_cache);
+  if (ff == NULL)
+    return -1;
+  ff->shm = shm_open (key, size);
+  if (ff->shm == NULL)
+  {
+    kmem_cache_free (file_fd_cache, ff);
+    return -1;
+  }
+  ff->file = NULL;
+  ff->pipe = NULL;
+  ff->nonblock = false;
+  ff->cloexec = false;
+  lock_acquire (&p->proc_lock);
+  ff->fd = ++p->fd;
+  list_push_back (&p->file_list, &ff->file_elem);
+  lock_release (&p->proc_lock);
+  return ff->fd;
+}
+
+/* Maps the shared memory segment open as FD at ADDR.  Returns
+   ADDR, or a null pointer on failure. */
+static void *sys_shm_map (int fd, void *addr)
+{
+  struct thread *p = process_current ();
+  void *res = NULL;
+  lock_acquire (&p->proc_lock);
+  struct file_fd *ff = lookup_fd (fd);
+  if (ff != NULL && ff->shm != NULL)
+    res = shm_map (ff->shm, addr);
+  lock_release (&p->proc_lock);
+  return res;
+}
+
+/* Unmaps the shared memory segment mapped at ADDR. */
+static bool sys_shm_unmap (void *addr)
+{
+  struct thread *p = process_current ();
+  lock_acquire (&p->proc_lock);
+  bool ok = shm_unmap (addr);
+  lock_release (&p->proc_lock);
+  return ok;
+}
+
+/* Starts a new thread in the running process at user address
+   EIP, which the user library points at a stub that calls
+   FUNCTION (AUX).  Returns its tid, or -1 on failure. */
+static tid_t sys_thread_create (void *eip, void *function, void *aux)
+{
+  if (!is_user_vaddr (eip))
+    return TID_ERROR;
+  return process_thread_create (eip, function, aux);
+}
+
+/* Sleeps until woken by futex_wake() if the int at ADDR still
+   holds EXPECTED.  Returns true if it slept.  See
+   userprog/futex.c. */
+static bool sys_futex_wait (int *addr, int expected)
+{
+  // 对齐保证该int不跨页
+  if ((uintptr_t) addr % sizeof *addr != 0 || isBad (addr))
+    exit (-1);
+  return futex_wait (addr, expected);
+}
+
+/* Wakes up to CNT threads sleeping on the int at ADDR.  Returns
+   the number woken. */
+static int sys_futex_wake (int *addr, int cnt)
+{
+  if ((uintptr_t) addr % sizeof *addr != 0 || isBad (addr))
+    exit (-1);
+  return futex_wake (addr, cnt);
+}
+
+/* Gets or sets the flags of descriptor FD: with F_GETFL, returns
+   them; with F_SETFL, sets them to ARG and returns 0.  The only
+   flag is O_NONBLOCK.  F_GETFD and F_SETFD do the same for the
+   FD_CLOEXEC flag.  Returns -1 if FD is not open or CMD is
+   unknown.  Descriptors 0 and 1 get an entry of their own the
+   first time, so that their flags have somewhere to live. */
+static int fcntl (int fd, int cmd, int arg)
+{
+  struct thread *p = process_current ();
+  int res = -1;
+
+  lock_acquire (&p->proc_lock);
+  struct file_fd *ff = lookup_fd (fd);
+  if (ff == NULL && (fd == 0 || fd == 1)
+      && (ff = kmem_cache_alloc (file_fd_cache)) != NULL)
+  {
+    ff->file = NULL;
+    ff->pipe = NULL;
+    ff->shm = NULL;
+    ff->nonblock = false;
+    ff->cloexec = false;
+    ff->console_fd = fd;
+    ff->fd = fd;
+    list_push_back (&p->file_list, &ff->file_elem);
+  }
+  if (ff != NULL && cmd == F_GETFL)
+    res = ff->nonblock ? O_NONBLOCK : 0;
+  else if (ff != NULL && cmd == F_SETFL)
+  {
+    ff->nonblock = (arg & O_NONBLOCK) != 0;
+    res = 0;
+  }
+  else if (ff != NULL && cmd == F_GETFD)
+    res = ff->cloexec ? FD_CLOEXEC : 0;
+  else if (ff != NULL && cmd == F_SETFD)
+  {
+    ff->cloexec = (arg & FD_CLOEXEC) != 0;
+    res = 0;
+  }
+  lock_release (&p->proc_lock);
+  return res;
+}
+
+/* Waits until at least one of the NFDS descriptors in FDS has an
+   event of interest, or until TIMEOUT milliseconds pass: forever
+   if TIMEOUT is negative, not at all if it is 0.  Sets each
+   revents member and returns the number of descriptors with
+   events, 0 on timeout, or -1 if NFDS exceeds POLL_MAX or memory
+   is short. */
+static int poll (struct pollfd *fds, unsigned nfds, int timeout)
+{
+  struct thread *p = process_current ();
+  struct pollfd kfds[POLL_MAX];
+  struct poll_slot *slots = NULL;
+  struct poller poller;
+  unsigned i;
+  int ready;
+
+  if (nfds > POLL_MAX)
+    return -1;
+
+  /* Work on a copy of FDS: another thread may unmap it while we
+     sleep, and a page fault can't be survived under proc_lock.
+     The copy lives on our stack, so a fault copying FDS in or
+     out, with nothing held, leaks nothing. */
+  if (nfds > 0 && (isBad (fds) || !check_buffer (fds, nfds * sizeof *fds)))
+    exit (-1);
+  memcpy (kfds, fds, nfds * sizeof *fds);
+  if (nfds > 0 && (slots = malloc (nfds * sizeof *slots)) == NULL)
+    return -1;
+
+  sema_init (&poller.wakeup, 0);
+  poller.timed_out = false;
+  timer_event_init (&poller.timeout, poll_timeout, &poller);
+  if (timeout > 0)
+    timer_event_add (&poller.timeout, (int64_t) timeout * 1000 * 1000);
+
+  for (;;)
+  {
+    // 先挂到各对象的等待队列上再检查, 以免漏掉其间的唤醒.
+    ready = 0;
+    lock_acquire (&p->proc_lock);
+    for (i = 0; i < nfds; i++)
     {
-      f = ff->file;
-      break;
+      slots[i].entry.sema = NULL;
+      slots[i].pipe = NULL;
+      kfds[i].revents = poll_fd (&kfds[i], timeout != 0 ? &slots[i] : NULL,
+                                 &poller.wakeup);
+      if (kfds[i].revents != 0)
+        ready++;
     }
+    lock_release (&p->proc_lock);
+
+    bool done = ready > 0 || timeout == 0 || poller.timed_out || p->exiting;
+    if (!done)
+      sleep_or_exit (&poller.wakeup);
+    for (i = 0; i < nfds; i++)
+    {
+      wait_queue_remove (&slots[i].entry);
+      if (slots[i].pipe != NULL)
+        pipe_close (slots[i].pipe, slots[i].pipe_writer);
+    }
+    if (done)
+      break;
   }
-  if (f == NULL)
-    return 0;
-  return file_tell (f);
+
+  timer_event_cancel (&poller.timeout);
+  free (slots);
+
+  // 睡眠期间FDS可能已被解除映射, 再检查一次
+  if (nfds > 0 && (isBad (fds) || !check_buffer (fds, nfds * sizeof *fds)))
+    exit (-1);
+  for (i = 0; i < nfds; i++)
+    fds[i].revents = kfds[i].revents;
+  return ready;
 }
 
-static void close (int fd) 
+/* Returns the events ready on descriptor PFD->fd, limited to
+   those in PFD->events plus those always reported.  Unless SLOT
+   is null, also puts SLOT's entry on the wait queue of what the
+   descriptor refers to, to up WAKEUP whenever that may change.
+   The caller must hold the process's proc_lock. */
+static int poll_fd (struct pollfd *pfd, struct poll_slot *slot,
+                    struct semaphore *wakeup)
 {
-  if (fd == 0 || fd == 1 || fd > thread_current ()->fd)
-    return ;
-  struct list_elem *e;
-  struct file *f = NULL;
-  struct file_fd *ff;
-  for (e = list_begin (&thread_current ()->file_list); e != list_end (&thread_current ()->file_list);
-      e = list_next (e))
+  struct wait_entry *e = slot != NULL ? &slot->entry : NULL;
+  int events;
+
+  if (pfd->fd < 0)
+    return 0;
+  struct file_fd *ff = lookup_fd (pfd->fd);
+  if (ff != NULL && ff->pipe != NULL)
   {
-    ff = list_entry (e, struct file_fd, file_elem);
-    if (ff->fd == fd)
+    if (slot != NULL)
     {
-      f = ff->file;
-      break;
+      /* Keep the pipe alive while SLOT is on its queue, even if
+         another thread closes the descriptor meanwhile. */
+      pipe_dup (ff->pipe, ff->pipe_writer);
+      slot->pipe = ff->pipe;
+      slot->pipe_writer = ff->pipe_writer;
     }
+    events = pipe_poll (ff->pipe, ff->pipe_writer, e, wakeup);
   }
-  if (f == NULL)
-    return ;
-  list_remove (&ff->file_elem);
-  file_allow_write (f);
-  free (wt);
-  file_close (f);
+  else if (ff != NULL && ff->file != NULL)
+    events = POLLIN | POLLOUT;          // 普通文件从不阻塞
+  else if (is_console (ff, pfd->fd, 0))
+    events = input_poll (e, wakeup) ? POLLIN : 0;
+  else if (is_console (ff, pfd->fd, 1))
+    events = POLLOUT;
+  else
+    return POLLNVAL;                    // Not open, or shared memory.
+  return events & (pfd->events | POLLERR | POLLHUP);
+}
+
+/* Timer event function for poll(): wakes the poller. */
+static void poll_timeout (void *poller_)
+{
+  struct poller *poller = poller_;
+  poller->timed_out = true;
+  sema_up (&poller->wakeup);
 }
 
 /* Reads a byte at user virtual address UADDR.
@@ -3,7 +3,11 @@
 
 static struct lock rox_lock;
 
+struct thread;
+
 void syscall_init (void);
+void syscall_inherit_fds (struct thread *parent);
+void syscall_close_fds (void);
 void exit(int status);
 
 #endif /* userprog/syscall.h */